@@ -0,0 +1,11 @@
+#version 330 core
+in vec2 oTexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D uTexture;
+
+// unlit: the impostor is lit by the level shader when it is drawn
+void main() {
+    FragColor = texture(uTexture, oTexCoord);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+in vec2 oTexCoord;
+in vec4 oColor;
+
+out vec4 FragColor;
+
+uniform sampler2D uTexture;
+
+void main() {
+    FragColor = oColor * texture(uTexture, oTexCoord);
+    if (FragColor.a < 0.01)
+        discard;
+}
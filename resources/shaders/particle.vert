@@ -0,0 +1,33 @@
+#version 330 core
+layout (location=0) in vec2 aCorner;
+// per particle
+layout (location=1) in float aX;
+layout (location=2) in float aY;
+layout (location=3) in float aZ;
+layout (location=4) in float aSize;
+layout (location=5) in float aFade;     // fraction of life left
+layout (location=6) in vec4 aColor;
+
+out vec2 oTexCoord;
+out vec4 oColor;
+
+uniform mat4 uView;
+uniform mat4 uProjection;
+uniform vec2 uFrameGrid;                // columns and rows of animation frames in the texture
+uniform float uNumFrames;
+
+void main() {
+    // face the camera: the first two rows of the view matrix are its right and up axes
+    vec3 right = vec3(uView[0][0], uView[1][0], uView[2][0]);
+    vec3 up = vec3(uView[0][1], uView[1][1], uView[2][1]);
+    vec3 position = vec3(aX, aY, aZ) + aSize * (aCorner.x * right + aCorner.y * up);
+    gl_Position = uProjection * uView * vec4(position, 1.0);
+
+    // play the frames once over the particle's life, row by row from the top
+    float frame = min(floor((1.0 - clamp(aFade, 0.0, 1.0)) * uNumFrames), uNumFrames - 1.0);
+    vec2 cell = vec2(mod(frame, uFrameGrid.x), uFrameGrid.y - 1.0 - floor(frame / uFrameGrid.x));
+    oTexCoord = (cell + aCorner + 0.5) / uFrameGrid;
+
+    oColor = aColor;
+    oColor.a *= clamp(4.0 * aFade, 0.0, 1.0);    // fade out over the last quarter of its life
+}
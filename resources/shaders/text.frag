@@ -0,0 +1,11 @@
+#version 330 core
+in vec2 oTexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D uTexture;
+uniform vec3 uColor;
+
+void main() {
+    FragColor = vec4(uColor, 1.0) * texture(uTexture, oTexCoord);
+}
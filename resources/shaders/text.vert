@@ -0,0 +1,12 @@
+#version 330 core
+layout (location=0) in vec2 aPos;
+layout (location=1) in vec2 aTexCoord;
+
+out vec2 oTexCoord;
+
+uniform mat4 uProjection;
+
+void main() {
+    gl_Position = uProjection * vec4(aPos, 0.0, 1.0);      // aPos is in screen pixels
+    oTexCoord = aTexCoord;
+}
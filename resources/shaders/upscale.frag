@@ -0,0 +1,14 @@
+#version 330 core
+in vec2 oTexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D uTexture;
+uniform vec2 uExtent;       // the part of the texture the scene was drawn into
+uniform vec2 uHalfTexel;
+
+// bilinear upscale of the lower left corner of the render target
+void main() {
+    vec2 texCoord = clamp(oTexCoord * uExtent, uHalfTexel, uExtent - uHalfTexel);
+    FragColor = texture(uTexture, texCoord);
+}
@@ -0,0 +1,145 @@
+#include "archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // bytes taken by levels mip levels of RGBA8 pixels, each half the size of
+    // the one before down to 1x1; 0 if that isn't a possible mip chain
+    uint64_t getMipChainSize(uint64_t width, uint64_t height, const uint32_t levels) {
+        if (width == 0 || height == 0 || levels == 0 || levels > 32)
+            return 0;
+        uint64_t size = 0;
+        for (uint32_t level = 0; level < levels; ++level) {
+            size += width * height * 4;
+            width = std::max<uint64_t>(1, width / 2);
+            height = std::max<uint64_t>(1, height / 2);
+        }
+        return size;
+    }
+
+    bool isValid(const ph::archive::Entry& entry, const size_t archiveSize) {
+        // names are compared with strcmp, so must end within the field
+        if (!std::memchr(entry.name, '\0', sizeof(entry.name)))
+            return false;
+        if (entry.offset > archiveSize || entry.size > archiveSize - entry.offset)
+            return false;
+        // textures are uploaded level by level straight out of the payload
+        if (entry.type == ph::archive::EntryType::Texture &&
+            getMipChainSize(entry.width, entry.height, entry.mipLevels) != entry.size)
+            return false;
+        return true;
+    }
+}
+
+// class ph::Archive
+ph::Archive::Archive(const std::string& path) {
+    // MAP THE FILE
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        std::cerr << "Error: Failed to open archive at " << path << "!\n";
+        return;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        std::cerr << "Error: Failed to map archive at " << path << "!\n";
+        return;
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Failed to open archive at " << path << "!\n";
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const uint8_t*>(mapped);
+            size = info.st_size;
+        }
+    }
+    close(fd);      // the mapping keeps the file alive
+    if (!data) {
+        std::cerr << "Error: Failed to map archive at " << path << "!\n";
+        return;
+    }
+#endif
+
+    // VALIDATE HEADER AND INDEX
+    const auto header = reinterpret_cast<const archive::Header*>(data);
+    bool valid = size >= sizeof(archive::Header) && std::memcmp(header->magic, archive::MAGIC, 4) == 0 &&
+                 header->version == archive::VERSION &&
+                 size >= sizeof(archive::Header) + header->entryCount * sizeof(archive::Entry);
+    if (valid) {
+        const auto entries = reinterpret_cast<const archive::Entry*>(data + sizeof(archive::Header));
+        for (uint32_t i = 0; i < header->entryCount; ++i) {
+            if (!isValid(entries[i], size))
+                valid = false;
+        }
+    }
+    if (!valid) {
+        std::cerr << "Error: " << path << " is not a valid version " << archive::VERSION << " archive!\n";
+        unmap();
+    }
+}
+ph::Archive::~Archive() {
+    unmap();
+}
+void ph::Archive::unmap() {
+#ifdef _WIN32
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    mapping = file = nullptr;
+#else
+    if (data)
+        munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+bool ph::Archive::isOpen() const {
+    return data != nullptr;
+}
+const ph::archive::Entry* ph::Archive::find(const std::string& name) const {
+    if (!data)
+        return nullptr;
+
+    // the index is sorted by name, so binary search it
+    const auto header = reinterpret_cast<const archive::Header*>(data);
+    const auto begin = reinterpret_cast<const archive::Entry*>(data + sizeof(archive::Header));
+    const auto end = begin + header->entryCount;
+    const auto entry = std::lower_bound(begin, end, name, [](const archive::Entry& e, const std::string& n) {
+        return std::strcmp(e.name, n.c_str()) < 0;
+    });
+    if (entry == end || name != entry->name)
+        return nullptr;
+    return entry;
+}
+const uint8_t* ph::Archive::getData(const archive::Entry& entry) const {
+    return data + entry.offset;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ph {
+    // On-disk layout of a resource archive, as written by tools/pack.cpp.
+    //
+    // An archive is a Header, followed by an index of Entries sorted by name,
+    // followed by the entry payloads (each aligned to PAYLOAD_ALIGNMENT). All
+    // integers are little endian. Texture payloads are raw RGBA8 pixels,
+    // already flipped for OpenGL, with the full mip chain stored level after
+    // level down to 1x1.
+    namespace archive {
+        constexpr char MAGIC[4] = {'P', 'H', 'P', 'K'};
+        constexpr uint32_t VERSION = 1;
+        constexpr size_t PAYLOAD_ALIGNMENT = 16;
+
+        enum class EntryType : uint32_t {
+            Raw, Texture
+        };
+
+        struct Header {
+            char magic[4];
+            uint32_t version;
+            uint32_t entryCount;
+            uint32_t reserved;
+        };
+
+        struct Entry {
+            char name[96];          // path relative to resources/, null terminated
+            uint64_t offset;        // from the start of the archive
+            uint64_t size;          // in bytes
+            EntryType type;
+            uint32_t width;         // textures only: size of mip level 0
+            uint32_t height;
+            uint32_t mipLevels;
+        };
+
+        static_assert(sizeof(Header) == 16, "archive::Header must match the on-disk layout");
+        static_assert(sizeof(Entry) == 128, "archive::Entry must match the on-disk layout");
+    }
+
+    // A read-only resource archive mapped into memory. Entries are looked up
+    // by their path relative to resources/, e.g. "textures/tilemap.png", and
+    // their payloads are read straight out of the mapping.
+    class Archive {
+        const uint8_t* data{nullptr};
+        size_t size{0};
+#ifdef _WIN32
+        void* file{nullptr};
+        void* mapping{nullptr};
+#endif
+
+        void unmap();
+
+    public:
+        explicit Archive(const std::string& path);
+        ~Archive();
+        Archive(const Archive&) = delete;
+        Archive& operator=(const Archive&) = delete;
+
+        // false if the file couldn't be mapped or failed validation: every
+        // entry must have a terminated name and lie within the file, and
+        // every texture's payload must be exactly its mip chain
+        bool isOpen() const;
+        // returns nullptr if there is no entry with that name
+        const archive::Entry* find(const std::string& name) const;
+        const uint8_t* getData(const archive::Entry& entry) const;
+    };
+}
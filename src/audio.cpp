@@ -0,0 +1,257 @@
+#include "audio.h"
+
+#include <algorithm>
+#include <iostream>
+
+#define STB_VORBIS_HEADER_ONLY
+#include "stb_vorbis.c"
+
+// class ph::audio::NullBackend
+ph::audio::NullBackend::NullBackend(const int sampleRate, const bool paced)
+    : sampleRate(sampleRate), paced(paced), start(std::chrono::steady_clock::now()) {}
+int ph::audio::NullBackend::getSampleRate() const {
+    return sampleRate;
+}
+void ph::audio::NullBackend::drain(SpscRing<float>& ring) {
+    if (!paced) {
+        framesConsumed += ring.skip(ring.getSize()) / NUM_CHANNELS;
+        return;
+    }
+    // consume only as many frames as a sound card would have played by now
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const auto due = static_cast<uint64_t>(elapsed * sampleRate);
+    if (due > framesConsumed)
+        framesConsumed += ring.skip((due - framesConsumed) * NUM_CHANNELS) / NUM_CHANNELS;
+}
+
+// class ph::audio::WavBackend
+ph::audio::WavBackend::WavBackend(const std::string& path, const int sampleRate)
+    : sampleRate(sampleRate), file(path, std::ios::binary),
+      samples(BLOCK_FRAMES * NUM_CHANNELS), pcm(BLOCK_FRAMES * NUM_CHANNELS) {
+    if (!file)
+        std::cerr << "Error: Failed to open " << path << " for writing!\n";
+    // the sizes in the header are patched in the destructor
+    writeHeader();
+}
+ph::audio::WavBackend::~WavBackend() {
+    writeHeader();
+}
+void ph::audio::WavBackend::writeHeader() {
+    const auto put32 = [this](const uint32_t v) {
+        const char bytes[4] = {char(v & 0xff), char(v >> 8 & 0xff), char(v >> 16 & 0xff), char(v >> 24 & 0xff)};
+        file.write(bytes, 4);
+    };
+    const auto put16 = [this](const uint16_t v) {
+        const char bytes[2] = {char(v & 0xff), char(v >> 8 & 0xff)};
+        file.write(bytes, 2);
+    };
+    const uint32_t blockAlign = NUM_CHANNELS * sizeof(int16_t);
+    const uint32_t dataSize = framesWritten * blockAlign;
+
+    file.seekp(0);
+    file.write("RIFF", 4);
+    put32(36 + dataSize);
+    file.write("WAVE", 4);
+    file.write("fmt ", 4);
+    put32(16);                              // fmt chunk size
+    put16(1);                               // PCM
+    put16(NUM_CHANNELS);
+    put32(sampleRate);
+    put32(sampleRate * blockAlign);         // byte rate
+    put16(blockAlign);
+    put16(16);                              // bits per sample
+    file.write("data", 4);
+    put32(dataSize);
+    file.seekp(0, std::ios::end);
+}
+int ph::audio::WavBackend::getSampleRate() const {
+    return sampleRate;
+}
+void ph::audio::WavBackend::drain(SpscRing<float>& ring) {
+    size_t n;
+    while ((n = ring.read(samples.data(), samples.size())) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            const float s = std::max(-1.0f, std::min(1.0f, samples[i]));
+            pcm[i] = static_cast<int16_t>(s * 32767.0f);
+        }
+        // .wav files are little endian, as is every platform we build for
+        file.write(reinterpret_cast<const char*>(pcm.data()), n * sizeof(int16_t));
+        framesWritten += n / NUM_CHANNELS;
+    }
+}
+
+// class ph::audio::Mixer
+ph::audio::Mixer::Mixer(std::unique_ptr<Backend> backend, const size_t maxVoices)
+    : backend(std::move(backend)), commands(256), output(4 * BLOCK_FRAMES * NUM_CHANNELS),
+      voices(maxVoices), mixBuffer(BLOCK_FRAMES * NUM_CHANNELS), decodeBuffer(BLOCK_FRAMES * NUM_CHANNELS) {
+    thread = std::thread(&Mixer::run, this);
+}
+ph::audio::Mixer::~Mixer() {
+    running.store(false, std::memory_order_release);
+    thread.join();
+
+    // hand any decoders still in flight to voices, then close everything
+    processCommands();
+    for (auto& voice : voices) {
+        if (voice.decoder)
+            stb_vorbis_close(voice.decoder);
+    }
+}
+ph::audio::VoiceID ph::audio::Mixer::play(const std::string& oggPath, const float volume, const bool loop) {
+    // opening only parses the stream headers; the samples are decoded on the mixer thread
+    int error = 0;
+    stb_vorbis* decoder = stb_vorbis_open_filename(oggPath.c_str(), &error, nullptr);
+    if (!decoder) {
+        std::cerr << "Error: Failed to open Ogg Vorbis stream at " << oggPath << "! (" << error << ")\n";
+        return INVALID_VOICE;
+    }
+    return start(decoder, oggPath, volume, loop);
+}
+ph::audio::VoiceID ph::audio::Mixer::play(const uint8_t* oggData, const size_t size, const float volume,
+                                          const bool loop) {
+    int error = 0;
+    stb_vorbis* decoder = stb_vorbis_open_memory(oggData, static_cast<int>(size), &error, nullptr);
+    if (!decoder) {
+        std::cerr << "Error: Failed to open Ogg Vorbis stream in memory! (" << error << ")\n";
+        return INVALID_VOICE;
+    }
+    return start(decoder, "Ogg Vorbis stream in memory", volume, loop);
+}
+ph::audio::VoiceID ph::audio::Mixer::start(stb_vorbis* decoder, const std::string& source, const float volume,
+                                           const bool loop) {
+    const stb_vorbis_info info = stb_vorbis_get_info(decoder);
+    if (static_cast<int>(info.sample_rate) != backend->getSampleRate()) {
+        std::cerr << "Warning: " << source << " is " << info.sample_rate << " Hz but the mixer runs at "
+                  << backend->getSampleRate() << " Hz!\n";
+    }
+
+    const VoiceID voice = nextVoice++;
+    if (nextVoice == INVALID_VOICE)
+        nextVoice = 1;
+    const Command command{Command::Type::Play, voice, decoder, std::min(info.channels, NUM_CHANNELS), volume, loop};
+    if (!postCommand(command)) {
+        stb_vorbis_close(decoder);
+        return INVALID_VOICE;
+    }
+    return voice;
+}
+void ph::audio::Mixer::stop(const VoiceID voice) {
+    postCommand({Command::Type::Stop, voice, nullptr, 0, 0.0f, false});
+}
+void ph::audio::Mixer::setVolume(const VoiceID voice, const float volume) {
+    postCommand({Command::Type::SetVolume, voice, nullptr, 0, volume, false});
+}
+double ph::audio::Mixer::getVoicesMixedPerMs() const {
+    const uint64_t ns = mixNanoseconds.load(std::memory_order_relaxed);
+    return ns ? voicesMixed.load(std::memory_order_relaxed) * 1.0e6 / ns : 0.0;
+}
+uint64_t ph::audio::Mixer::getVoicesMixed() const {
+    return voicesMixed.load(std::memory_order_relaxed);
+}
+bool ph::audio::Mixer::postCommand(const Command& command) {
+    if (!commands.push(command)) {
+        std::cerr << "Error: Audio command queue is full!\n";
+        return false;
+    }
+    return true;
+}
+void ph::audio::Mixer::run() {
+    while (running.load(std::memory_order_acquire)) {
+        processCommands();
+        if (output.getFree() >= mixBuffer.size())
+            mixBlock();
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        backend->drain(output);
+    }
+}
+void ph::audio::Mixer::processCommands() {
+    Command command;
+    while (commands.pop(command)) {
+        switch (command.type) {
+        case Command::Type::Play: {
+            const auto slot = std::find_if(voices.begin(), voices.end(), [](const Voice& v) {
+                return v.decoder == nullptr;
+            });
+            if (slot == voices.end()) {
+                // every voice is busy, drop the new sound
+                stb_vorbis_close(command.decoder);
+                break;
+            }
+            slot->id = command.voice;
+            slot->decoder = command.decoder;
+            slot->channels = command.channels;
+            slot->volume = command.volume;
+            slot->loop = command.loop;
+            break;
+        }
+        case Command::Type::Stop:
+            for (auto& voice : voices) {
+                if (voice.decoder && voice.id == command.voice) {
+                    stb_vorbis_close(voice.decoder);
+                    voice = Voice{};
+                }
+            }
+            break;
+        case Command::Type::SetVolume:
+            for (auto& voice : voices) {
+                if (voice.decoder && voice.id == command.voice)
+                    voice.volume = command.volume;
+            }
+            break;
+        }
+    }
+}
+void ph::audio::Mixer::mixBlock() {
+    const auto begin = std::chrono::steady_clock::now();
+    std::fill(mixBuffer.begin(), mixBuffer.end(), 0.0f);
+
+    uint64_t mixed = 0;
+    for (auto& voice : voices) {
+        if (!voice.decoder)
+            continue;
+
+        // decode one block, rewinding looping voices at the end of the stream
+        size_t frames = 0;
+        bool rewound = false;
+        while (frames < BLOCK_FRAMES) {
+            const int n = stb_vorbis_get_samples_float_interleaved(
+                voice.decoder, voice.channels, decodeBuffer.data() + frames * voice.channels,
+                static_cast<int>((BLOCK_FRAMES - frames) * voice.channels));
+            if (n > 0) {
+                frames += n;
+                rewound = false;
+            } else if (voice.loop && !rewound) {
+                stb_vorbis_seek_start(voice.decoder);
+                rewound = true;     // guards against empty streams
+            } else {
+                break;
+            }
+        }
+
+        // sum into the output, spreading mono voices over both channels
+        const float* in = decodeBuffer.data();
+        float* out = mixBuffer.data();
+        if (voice.channels == 1) {
+            for (size_t i = 0; i < frames; ++i) {
+                out[2 * i + 0] += voice.volume * in[i];
+                out[2 * i + 1] += voice.volume * in[i];
+            }
+        } else {
+            for (size_t i = 0; i < frames * NUM_CHANNELS; ++i)
+                out[i] += voice.volume * in[i];
+        }
+        ++mixed;
+
+        if (frames < BLOCK_FRAMES) {
+            stb_vorbis_close(voice.decoder);
+            voice = Voice{};
+        }
+    }
+    output.write(mixBuffer.data(), mixBuffer.size());
+
+    const auto elapsed = std::chrono::steady_clock::now() - begin;
+    voicesMixed.fetch_add(mixed, std::memory_order_relaxed);
+    mixNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                             std::memory_order_relaxed);
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct stb_vorbis;
+
+namespace ph {
+    namespace audio {
+        // The mixer always produces interleaved stereo frames.
+        constexpr int NUM_CHANNELS = 2;
+        // Frames mixed per pass; small enough to keep latency low, large
+        // enough that per-voice decode overhead is amortized.
+        constexpr size_t BLOCK_FRAMES = 512;
+
+        // Lock-free single-producer, single-consumer ring buffer. One thread
+        // may push/write, one other thread may pop/read. The capacity is
+        // rounded up to a power of two so indices can be masked instead of
+        // wrapped with a modulo.
+        template<typename T>
+        class SpscRing {
+            std::vector<T> buffer;
+            size_t mask;
+            std::atomic<size_t> head{0}; // next slot to read, owned by the consumer
+            std::atomic<size_t> tail{0}; // next slot to write, owned by the producer
+
+        public:
+            explicit SpscRing(size_t capacity) {
+                size_t size = 1;
+                while (size < capacity)
+                    size <<= 1;
+                buffer.resize(size);
+                mask = size - 1;
+            }
+
+            size_t getCapacity() const { return buffer.size(); }
+            size_t getSize() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+            size_t getFree() const { return getCapacity() - getSize(); }
+
+            bool push(const T& value) {
+                const size_t t = tail.load(std::memory_order_relaxed);
+                if (t - head.load(std::memory_order_acquire) == buffer.size())
+                    return false;
+                buffer[t & mask] = value;
+                tail.store(t + 1, std::memory_order_release);
+                return true;
+            }
+            bool pop(T& value) {
+                const size_t h = head.load(std::memory_order_relaxed);
+                if (tail.load(std::memory_order_acquire) == h)
+                    return false;
+                value = buffer[h & mask];
+                head.store(h + 1, std::memory_order_release);
+                return true;
+            }
+            // writes as many of the n values as fit, returns the number written
+            size_t write(const T* values, size_t n) {
+                const size_t t = tail.load(std::memory_order_relaxed);
+                const size_t free = buffer.size() - (t - head.load(std::memory_order_acquire));
+                if (n > free)
+                    n = free;
+                for (size_t i = 0; i < n; ++i)
+                    buffer[(t + i) & mask] = values[i];
+                tail.store(t + n, std::memory_order_release);
+                return n;
+            }
+            // reads up to n values, returns the number read
+            size_t read(T* values, size_t n) {
+                const size_t h = head.load(std::memory_order_relaxed);
+                const size_t size = tail.load(std::memory_order_acquire) - h;
+                if (n > size)
+                    n = size;
+                for (size_t i = 0; i < n; ++i)
+                    values[i] = buffer[(h + i) & mask];
+                head.store(h + n, std::memory_order_release);
+                return n;
+            }
+            // discards up to n values, returns the number discarded
+            size_t skip(size_t n) {
+                const size_t h = head.load(std::memory_order_relaxed);
+                const size_t size = tail.load(std::memory_order_acquire) - h;
+                if (n > size)
+                    n = size;
+                head.store(h + n, std::memory_order_release);
+                return n;
+            }
+        };
+
+        // An output backend consumes the mixed samples. drain() is called on
+        // the mixer thread after every mix pass and should read whatever it
+        // can from the ring. A callback-driven sound card backend would read
+        // the ring from its own callback instead and leave drain() empty.
+        class Backend {
+        public:
+            virtual ~Backend() = default;
+
+            virtual int getSampleRate() const = 0;
+            virtual void drain(SpscRing<float>& ring) = 0;
+        };
+
+        // Discards all samples. When paced, samples are consumed at the real
+        // sample rate like a sound card would; otherwise the mixer runs as
+        // fast as it can, which is what throughput measurements want.
+        class NullBackend : public Backend {
+            int sampleRate;
+            bool paced;
+            std::chrono::steady_clock::time_point start;
+            uint64_t framesConsumed{0};
+
+        public:
+            explicit NullBackend(int sampleRate = 44100, bool paced = true);
+
+            int getSampleRate() const override;
+            void drain(SpscRing<float>& ring) override;
+        };
+
+        // Writes all samples to a 16-bit PCM .wav file as fast as they are mixed.
+        class WavBackend : public Backend {
+            int sampleRate;
+            std::ofstream file;
+            uint32_t framesWritten{0};
+            std::vector<float> samples;
+            std::vector<int16_t> pcm;
+
+            void writeHeader();
+
+        public:
+            WavBackend(const std::string& path, int sampleRate = 44100);
+            ~WavBackend() override;
+
+            int getSampleRate() const override;
+            void drain(SpscRing<float>& ring) override;
+        };
+
+        using VoiceID = uint32_t;
+        constexpr VoiceID INVALID_VOICE = 0;
+
+        // Mixes streaming Ogg Vorbis voices on a dedicated thread.
+        //
+        // The game thread talks to the mixer only through a lock-free command
+        // queue: play() opens the decoder (which only reads the stream headers)
+        // and hands it over, and stop()/setVolume() post small commands. The
+        // mixer thread decodes each voice one block at a time, sums the voices
+        // and pushes the result into a ring buffer that the backend drains.
+        class Mixer {
+            struct Command {
+                enum class Type { Play, Stop, SetVolume } type;
+                VoiceID voice;
+                stb_vorbis* decoder;
+                int channels;
+                float volume;
+                bool loop;
+            };
+            struct Voice {
+                VoiceID id{INVALID_VOICE};
+                stb_vorbis* decoder{nullptr};
+                int channels{0};
+                float volume{1.0f};
+                bool loop{false};
+            };
+
+            std::unique_ptr<Backend> backend;
+            SpscRing<Command> commands;
+            SpscRing<float> output;
+
+            // only touched by the mixer thread
+            std::vector<Voice> voices;
+            std::vector<float> mixBuffer;
+            std::vector<float> decodeBuffer;
+
+            VoiceID nextVoice{1};
+            std::atomic<bool> running{true};
+            std::atomic<uint64_t> voicesMixed{0};
+            std::atomic<uint64_t> mixNanoseconds{0};
+            std::thread thread;
+
+            void run();
+            void processCommands();
+            void mixBlock();
+            VoiceID start(stb_vorbis* decoder, const std::string& source, float volume, bool loop);
+            bool postCommand(const Command& command);
+
+        public:
+            explicit Mixer(std::unique_ptr<Backend> backend, size_t maxVoices = 32);
+            ~Mixer();
+            Mixer(const Mixer&) = delete;
+            Mixer& operator=(const Mixer&) = delete;
+
+            VoiceID play(const std::string& oggPath, float volume = 1.0f, bool loop = false);
+            // streams from an Ogg Vorbis file in memory, e.g. an archive entry;
+            // the data must stay alive until the voice has finished
+            VoiceID play(const uint8_t* oggData, size_t size, float volume = 1.0f, bool loop = false);
+            void stop(VoiceID voice);
+            void setVolume(VoiceID voice, float volume);
+
+            // number of voice blocks mixed per millisecond spent mixing
+            double getVoicesMixedPerMs() const;
+            uint64_t getVoicesMixed() const;
+        };
+    }
+}
@@ -0,0 +1,153 @@
+#include "draw.h"
+
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace {
+    // ties are broken by the vertex range so the order doesn't depend on which worker recorded what
+    bool isBefore(const ph::DrawCommand& a, const ph::DrawCommand& b) {
+        return a.key != b.key ? a.key < b.key : a.first < b.first;
+    }
+}
+
+// struct ph::Frustum
+ph::Frustum::Frustum(const glm::mat4& m) {
+    // Gribb-Hartmann: each plane is the last row of the matrix plus or minus
+    // another row (glm matrices are indexed [column][row])
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4 row{m[0][i], m[1][i], m[2][i], m[3][i]};
+        const glm::vec4 last{m[0][3], m[1][3], m[2][3], m[3][3]};
+        planes[2 * i + 0] = last + row;
+        planes[2 * i + 1] = last - row;
+    }
+}
+bool ph::Frustum::intersects(const glm::vec3& min, const glm::vec3& max) const {
+    for (const auto& plane : planes) {
+        // the corner of the box furthest along the plane normal
+        const glm::vec3 corner{plane.x > 0.0f ? max.x : min.x,
+                               plane.y > 0.0f ? max.y : min.y,
+                               plane.z > 0.0f ? max.z : min.z};
+        if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// class ph::CommandList
+void ph::CommandList::draw(const Shader& shader, const Texture& texture, const VertexArray& vertexArray,
+                           const size_t first, const size_t count, const glm::mat4& model, const float depth) {
+    // 16 bits each: shader, texture, vertex array, depth
+    const auto d = static_cast<uint64_t>(std::max(0.0f, std::min(1.0f, depth)) * 0xffff);
+    const uint64_t key = static_cast<uint64_t>(shader.getID() & 0xffff) << 48 |
+                         static_cast<uint64_t>(texture.getID() & 0xffff) << 32 |
+                         static_cast<uint64_t>(vertexArray.getID() & 0xffff) << 16 | d;
+    commands.push_back({key, &shader, &texture, &vertexArray, first, count, model});
+}
+void ph::CommandList::addLight(const Light& light) {
+    lights.push_back(light);
+}
+void ph::CommandList::clear() {
+    commands.clear();
+    lights.clear();
+}
+
+// class ph::DrawLists
+ph::DrawLists::DrawLists(jobs::Scheduler& scheduler) : scheduler(scheduler) {
+    for (unsigned i = 0; i < scheduler.getNumWorkers(); ++i)
+        lists.emplace_back(new CommandList);
+    cursors.reserve(lists.size());
+}
+void ph::DrawLists::begin(const glm::mat4& view, const glm::mat4& projection) {
+    for (auto& list : lists)
+        list->clear();
+    this->view = view;
+    this->projection = projection;
+    viewProjection = projection * view;
+    frustum = Frustum{viewProjection};
+    // the camera sits at the origin of view space
+    const glm::mat4 inverseView = glm::inverse(view);
+    eye = glm::vec3{inverseView[3][0], inverseView[3][1], inverseView[3][2]};
+}
+ph::CommandList& ph::DrawLists::getList() {
+    return *lists[jobs::Scheduler::getCurrentWorker()];
+}
+const ph::Frustum& ph::DrawLists::getFrustum() const {
+    return frustum;
+}
+float ph::DrawLists::getDepth(const glm::vec3& point) const {
+    const glm::vec4 clip = viewProjection * glm::vec4{point, 1.0f};
+    return clip.w > 0.0f ? 0.5f * clip.z / clip.w + 0.5f : 0.0f;
+}
+void ph::DrawLists::submit() {
+    // sort on the workers, so this thread only has to merge
+    scheduler.parallelFor(0, lists.size(), 1, [this](const size_t first, const size_t last) {
+        for (size_t i = first; i < last; ++i)
+            std::sort(lists[i]->commands.begin(), lists[i]->commands.end(), isBefore);
+    });
+
+    cursors.clear();
+    const Light* light = nullptr;
+    float lightDistance = 0.0f;
+    for (const auto& list : lists) {
+        const auto& commands = list->commands;
+        if (!commands.empty())
+            cursors.push_back({commands.data(), commands.data() + commands.size()});
+        for (const auto& l : list->lights) {
+            const glm::vec3 d = l.position - eye;
+            const float distance = glm::dot(d, d);
+            if (!light || distance < lightDistance) {
+                light = &l;
+                lightDistance = distance;
+            }
+        }
+    }
+    // k-way merge: the cursors form a heap with the earliest next command on top
+    const auto isLater = [](const Cursor& a, const Cursor& b) {
+        return isBefore(*b.next, *a.next);
+    };
+    std::make_heap(cursors.begin(), cursors.end(), isLater);
+
+    const Shader* shader = nullptr;
+    const Texture* texture = nullptr;
+    const VertexArray* vertexArray = nullptr;
+    GLint modelLocation = -1;
+    submitted = 0;
+    while (!cursors.empty()) {
+        std::pop_heap(cursors.begin(), cursors.end(), isLater);
+        auto& cursor = cursors.back();
+        const DrawCommand& command = *cursor.next;
+        if (++cursor.next == cursor.end)
+            cursors.pop_back();
+        else
+            std::push_heap(cursors.begin(), cursors.end(), isLater);
+
+        if (command.shader != shader) {
+            shader = command.shader;
+            gl::bind(*shader);
+            // plain C strings: some of these names are too long for std::string's small buffer
+            const GLuint id = shader->getID();
+            glUniformMatrix4fv(glGetUniformLocation(id, "uView"), 1, GL_FALSE, glm::value_ptr(view));
+            glUniformMatrix4fv(glGetUniformLocation(id, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
+            if (light) {
+                glUniform3fv(glGetUniformLocation(id, "uLamp.position"), 1, glm::value_ptr(light->position));
+                glUniform3fv(glGetUniformLocation(id, "uLamp.color"), 1, glm::value_ptr(light->color));
+                glUniform3fv(glGetUniformLocation(id, "uLamp.attenuation"), 1, glm::value_ptr(light->attenuation));
+            }
+            modelLocation = glGetUniformLocation(id, "uModel");
+        }
+        if (command.texture != texture) {
+            texture = command.texture;
+            gl::bind(*texture);
+        }
+        if (command.vertexArray != vertexArray) {
+            vertexArray = command.vertexArray;
+            gl::bind(*vertexArray);
+        }
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(command.model));
+        gl::draw(*vertexArray, command.first, command.count);
+        ++submitted;
+    }
+}
+size_t ph::DrawLists::getNumSubmitted() const {
+    return submitted;
+}
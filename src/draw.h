@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+#include "ph.h"
+
+namespace ph {
+    // The six planes of a view frustum, pointing inwards.
+    struct Frustum {
+        glm::vec4 planes[6];
+
+        explicit Frustum(const glm::mat4& viewProjection);
+        // false only if the box is entirely outside
+        bool intersects(const glm::vec3& min, const glm::vec3& max) const;
+    };
+
+    struct DrawCommand {
+        uint64_t key;           // state, then depth; see CommandList::draw()
+        const Shader* shader;
+        const Texture* texture;
+        const VertexArray* vertexArray;
+        size_t first;
+        size_t count;
+        glm::mat4 model;
+    };
+    // A point light; the nearest one to the camera lights the scene.
+    struct Light {
+        glm::vec3 position;
+        glm::vec3 color;
+        glm::vec3 attenuation;  // constant, linear and quadratic terms
+    };
+
+    // Draws and lights recorded by one thread. Recording only fills in
+    // plain structs, so it can run on any thread; nothing touches GL until
+    // the lists are submitted.
+    class CommandList {
+        std::vector<DrawCommand> commands;
+        std::vector<Light> lights;
+        friend class DrawLists;
+
+    public:
+        // depth is the normalized depth of the object (0 at the near plane,
+        // 1 at the far plane), used to draw front to back within a state
+        void draw(const Shader& shader, const Texture& texture, const VertexArray& vertexArray,
+                  size_t first, size_t count, const glm::mat4& model, float depth);
+        void addLight(const Light& light);
+        void clear();
+    };
+
+    // Records a frame's draws in parallel and submits them on the GL thread.
+    //
+    // Every worker of the scheduler gets its own CommandList, so jobs can cull
+    // and record without locking. submit() sorts every list by shader, texture
+    // and vertex array (then front to back) to keep state changes down, one
+    // list per job on the workers, then merges the sorted lists as it replays
+    // them. Shaders are given uView, uProjection, uModel and the uLamp of the
+    // nearest light.
+    class DrawLists {
+        // the next command of a sorted list, for the merge
+        struct Cursor {
+            const DrawCommand* next;
+            const DrawCommand* end;
+        };
+
+        jobs::Scheduler& scheduler;
+        std::vector<std::unique_ptr<CommandList>> lists;
+        std::vector<Cursor> cursors;
+        glm::mat4 view{1.0f};
+        glm::mat4 projection{1.0f};
+        glm::mat4 viewProjection{1.0f};
+        glm::vec3 eye{0.0f};
+        Frustum frustum{glm::mat4{1.0f}};
+        size_t submitted{0};
+
+    public:
+        explicit DrawLists(jobs::Scheduler& scheduler);
+
+        // clears the lists and sets the camera for the frame; call before recording
+        void begin(const glm::mat4& view, const glm::mat4& projection);
+        // the calling worker's list
+        CommandList& getList();
+
+        const Frustum& getFrustum() const;
+        // normalized depth of a point, as CommandList::draw() takes it
+        float getDepth(const glm::vec3& point) const;
+
+        // sorts and replays every recorded command; must run on the GL thread
+        // after all recording jobs are done
+        void submit();
+        // number of draw calls of the last submit()
+        size_t getNumSubmitted() const;
+    };
+}
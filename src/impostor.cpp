@@ -0,0 +1,176 @@
+#include "impostor.h"
+
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+    // the largest atlas side allowed, in pixels
+    int getMaxAtlasSize(const int maxAtlasSize) {
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        return std::max(1, maxTextureSize > 0 ? std::min(maxAtlasSize, static_cast<int>(maxTextureSize))
+                                              : maxAtlasSize);
+    }
+
+    // a roughly square grid of slots, enough for every chunk if that fits
+    glm::ivec2 getAtlasSlots(const int numChunks, const int resolution, const int maxAtlasSize) {
+        const int maxSlots = std::max(1, maxAtlasSize / resolution);
+        const int numSlots = std::min(numChunks, maxSlots * maxSlots);
+        const int columns = std::min(maxSlots, static_cast<int>(std::ceil(std::sqrt(static_cast<float>(numSlots)))));
+        return {std::max(columns, 1), std::max((numSlots + columns - 1) / columns, 1)};
+    }
+
+    // one unit quad per slot, textured with the slot
+    std::vector<float> buildQuads(const glm::ivec2& slots, const int resolution) {
+        // pull the texCoords in by half a texel so filtering doesn't pick up the neighbouring slots
+        const glm::vec2 inset{0.5f / (slots.x * resolution), 0.5f / (slots.y * resolution)};
+
+        std::vector<float> vertices;
+        vertices.reserve(slots.x * slots.y * ChunkImpostors::VERTICES_PER_QUAD * 8);
+        for (int slot = 0; slot < slots.x * slots.y; ++slot) {
+            const float u0 = static_cast<float>(slot % slots.x) / slots.x + inset.x;
+            const float u1 = static_cast<float>(slot % slots.x + 1) / slots.x - inset.x;
+            const float v0 = static_cast<float>(slot / slots.x) / slots.y + inset.y;
+            const float v1 = static_cast<float>(slot / slots.x + 1) / slots.y - inset.y;
+            const float quad[] = {
+                // positions          // normals             // texCoords
+                0.0f, 0.0f, 0.5f,     0.0f, 0.0f, 1.0f,      u0, v0,
+                1.0f, 0.0f, 0.5f,     0.0f, 0.0f, 1.0f,      u1, v0,
+                1.0f, 1.0f, 0.5f,     0.0f, 0.0f, 1.0f,      u1, v1,
+                1.0f, 1.0f, 0.5f,     0.0f, 0.0f, 1.0f,      u1, v1,
+                0.0f, 1.0f, 0.5f,     0.0f, 0.0f, 1.0f,      u0, v1,
+                0.0f, 0.0f, 0.5f,     0.0f, 0.0f, 1.0f,      u0, v0,
+            };
+            vertices.insert(vertices.end(), quad, quad + sizeof(quad)/sizeof(float));
+        }
+        return vertices;
+    }
+}
+
+// class ChunkImpostors
+ChunkImpostors::ChunkImpostors(const ph::Archive& archive, const Level& level, const int resolution,
+                               const float switchHeight, const int maxAtlasSize)
+    : width(level.width), height(level.height), chunksX(level.getChunksX()),
+      resolution(std::min(resolution, getMaxAtlasSize(maxAtlasSize))), switchHeight(switchHeight),
+      slots(getAtlasSlots(level.getNumChunks(), this->resolution, getMaxAtlasSize(maxAtlasSize))),
+      atlas(slots.x * this->resolution, slots.y * this->resolution, false, true),
+      bakeShader(archive, "shaders/basic.vert", "shaders/impostor.frag"),
+      quads(buildQuads(slots, this->resolution).data(), slots.x * slots.y * VERTICES_PER_QUAD * 8, {3, 3, 2}),
+      slotOf(level.getNumChunks(), -1), chunkOf(slots.x * slots.y, -1), lastUsed(slots.x * slots.y, 0),
+      requested(level.getNumChunks()), requests(slots.x * slots.y) {
+    ph::gl::bind(bakeShader);
+    ph::gl::setUniform(bakeShader, "uTexture", 0);
+}
+Level::ChunkBounds ChunkImpostors::getChunkBounds(const int chunk) const {
+    const int x0 = chunk % chunksX * CHUNK_SIZE;
+    const int y0 = chunk / chunksX * CHUNK_SIZE;
+    return {x0, y0, std::min(x0 + CHUNK_SIZE, width), std::min(y0 + CHUNK_SIZE, height)};
+}
+int ChunkImpostors::findSlot() {
+    // clock sweep: an approximation of least recently used that needs no ordering
+    for (size_t i = 0; i < chunkOf.size(); ++i) {
+        const size_t slot = clockHand;
+        clockHand = (clockHand + 1) % chunkOf.size();
+        if (chunkOf[slot] < 0)
+            return slot;
+        if (lastUsed[slot] < frame) {
+            slotOf[chunkOf[slot]] = -1;
+            chunkOf[slot] = -1;
+            return slot;
+        }
+    }
+    return -1;
+}
+int ChunkImpostors::acquire(const int chunk) {
+    const int slot = slotOf[chunk];
+    if (slot >= 0) {
+        // each chunk is recorded by one job, so no two threads write the same slot
+        lastUsed[slot] = frame;
+        return slot;
+    }
+    if (!requested[chunk].exchange(true, std::memory_order_relaxed)) {
+        const size_t i = numRequests.fetch_add(1, std::memory_order_relaxed);
+        if (i < requests.size())
+            requests[i] = chunk;
+        else
+            requested[chunk].store(false, std::memory_order_relaxed);     // full; ask again next frame
+    }
+    return -1;
+}
+void ChunkImpostors::markDirty(const int chunk) {
+    const int slot = slotOf[chunk];
+    if (slot < 0)
+        return;
+    slotOf[chunk] = -1;
+    chunkOf[slot] = -1;
+}
+void ChunkImpostors::beginBake(const ph::Texture& tilemap) {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    ph::gl::bind(atlas);
+    ph::gl::bind(bakeShader);
+    ph::gl::bind(tilemap);
+    ph::gl::setUniform(bakeShader, "uView", glm::mat4{1.0f});
+    ph::gl::setUniform(bakeShader, "uModel", glm::mat4{1.0f});
+    // the tiles are flat, so nothing can be hidden
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+}
+void ChunkImpostors::bakeChunk(const int chunk, const int slot) {
+    const int x = slot % slots.x * resolution;
+    const int y = slot / slots.x * resolution;
+    glViewport(x, y, resolution, resolution);
+    glScissor(x, y, resolution, resolution);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // look straight down at the chunk, which fills the slot even if it is cut short
+    const auto b = getChunkBounds(chunk);
+    const auto projection = glm::ortho(b.x0 - 0.5f, b.x1 - 0.5f, b.y0 - 0.5f, b.y1 - 0.5f, -1.0f, 1.0f);
+    ph::gl::setUniform(bakeShader, "uProjection", projection);
+
+    slotOf[chunk] = slot;
+    chunkOf[slot] = chunk;
+    // it is drawn in the coming frame, so it mustn't be evicted before then
+    lastUsed[slot] = frame + 1;
+    ++numBaked;
+}
+void ChunkImpostors::endBake() {
+    glDisable(GL_SCISSOR_TEST);
+    glEnable(GL_DEPTH_TEST);
+    ph::gl::bind(atlas.getTexture());
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+bool ChunkImpostors::isActive(const float cameraHeight) const {
+    return cameraHeight > switchHeight;
+}
+float ChunkImpostors::getSwitchHeight() const {
+    return switchHeight;
+}
+void ChunkImpostors::setSwitchHeight(const float height) {
+    switchHeight = height;
+}
+const ph::VertexArray& ChunkImpostors::getVertexArray() const {
+    return quads;
+}
+const ph::Texture& ChunkImpostors::getTexture() const {
+    return atlas.getTexture();
+}
+size_t ChunkImpostors::getFirstVertex(const int slot) const {
+    return slot * VERTICES_PER_QUAD;
+}
+glm::mat4 ChunkImpostors::getModel(const int chunk) const {
+    const auto b = getChunkBounds(chunk);
+    const auto model = glm::translate(glm::mat4{1.0f}, glm::vec3{b.x0 - 0.5f, b.y0 - 0.5f, 0.0f});
+    return glm::scale(model, glm::vec3{static_cast<float>(b.x1 - b.x0), static_cast<float>(b.y1 - b.y0), 1.0f});
+}
+size_t ChunkImpostors::getNumSlots() const {
+    return chunkOf.size();
+}
+size_t ChunkImpostors::getNumBaked() const {
+    return numBaked;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "level.h"
+#include "ph.h"
+
+// Low-detail stand-ins for level chunks, for camera heights at which a tile
+// is only a few pixels across.
+//
+// A chunk is rendered once, unlit and seen from straight above, into a
+// resolution x resolution slot of a shared atlas. Above the switch height it
+// is then drawn as one textured quad instead of two triangles per tile. The
+// quads face up like the tiles do, so the level shader lights them the same
+// way.
+//
+// The atlas has a bounded number of slots, however large the level is: it
+// is no larger than maxAtlasSize or GL_MAX_TEXTURE_SIZE on a side. Slots are
+// handed out to the chunks that are actually drawn, and the least recently
+// drawn chunks give theirs up when the atlas is full. Chunks are only ever
+// baked when they are asked for, and at most MAX_BAKES_PER_UPDATE at a time;
+// until then they are drawn at full detail.
+//
+// The level must keep the size it had when the impostors were created, and
+// whatever edits its tiles must call markDirty() for the chunks it changed.
+class ChunkImpostors {
+    const int width;
+    const int height;
+    const int chunksX;
+    const int resolution;
+    float switchHeight;
+    const glm::ivec2 slots;             // columns and rows of the atlas
+    ph::Framebuffer atlas;
+    const ph::Shader bakeShader;
+    const ph::VertexArray quads;        // one per slot
+
+    std::vector<int> slotOf;            // per chunk: its slot, or -1
+    std::vector<int> chunkOf;           // per slot: its chunk, or -1
+    std::vector<uint32_t> lastUsed;     // per slot: frame it was last drawn in
+    uint32_t frame{1};
+    size_t clockHand{0};                // where the search for a slot to evict resumes
+
+    // chunks asked for while recording, baked by the next update()
+    std::vector<std::atomic<bool>> requested;
+    std::vector<int> requests;
+    std::atomic<size_t> numRequests{0};
+    size_t numBaked{0};
+
+    // what baking changes, to be restored afterwards
+    GLint previousFramebuffer{0};
+    GLint previousViewport[4]{};
+
+    Level::ChunkBounds getChunkBounds(int chunk) const;
+    // a free slot, or the one of a chunk that wasn't drawn last frame; -1 if every slot is in use
+    int findSlot();
+    void beginBake(const ph::Texture& tilemap);
+    void bakeChunk(int chunk, int slot);
+    void endBake();
+
+public:
+    static constexpr size_t VERTICES_PER_QUAD = 6;
+    static constexpr size_t MAX_BAKES_PER_UPDATE = 64;
+
+    ChunkImpostors(const ph::Archive& archive, const Level& level, int resolution = 64,
+                   float switchHeight = 24.0f, int maxAtlasSize = 2048);
+
+    // Bakes the chunks asked for by acquire() since the last update; call
+    // once a frame before recording. For each one, drawChunk(chunk) is called
+    // with the bake shader and tilemap bound and must draw that chunk at
+    // full detail.
+    template<typename DrawChunk>
+    void update(const ph::Texture& tilemap, DrawChunk drawChunk) {
+        const size_t n = std::min(numRequests.load(std::memory_order_relaxed), requests.size());
+        size_t baked = 0;
+        bool full = false;
+        for (size_t i = 0; i < n; ++i) {
+            const int chunk = requests[i];
+            requested[chunk].store(false, std::memory_order_relaxed);
+            // past the budget, the chunk is asked for again next frame if it is still in view
+            if (slotOf[chunk] >= 0 || baked == MAX_BAKES_PER_UPDATE || full)
+                continue;
+            const int slot = findSlot();
+            if (slot < 0) {
+                full = true;
+                continue;
+            }
+            if (baked++ == 0)
+                beginBake(tilemap);
+            bakeChunk(chunk, slot);
+            drawChunk(chunk);
+        }
+        if (baked > 0)
+            endBake();
+        numRequests.store(0, std::memory_order_relaxed);
+        ++frame;
+    }
+
+    // Returns the slot holding the impostor of a chunk, to be drawn from
+    // getFirstVertex(slot) with getModel(chunk), or -1 if it isn't baked, in
+    // which case the chunk is queued for the next update() and should be
+    // drawn at full detail for now. Safe to call from recording jobs; each
+    // chunk must be acquired at most once a frame.
+    int acquire(int chunk);
+    // forgets the impostor of a chunk whose tiles changed; call on the GL thread, not while recording
+    void markDirty(int chunk);
+
+    // whether chunks should be drawn as impostors from this camera height
+    bool isActive(float cameraHeight) const;
+    float getSwitchHeight() const;
+    void setSwitchHeight(float height);
+
+    // the quad of a slot is VERTICES_PER_QUAD vertices from getFirstVertex(slot);
+    // it covers the unit square and getModel(chunk) fits it over the chunk
+    const ph::VertexArray& getVertexArray() const;
+    const ph::Texture& getTexture() const;
+    size_t getFirstVertex(int slot) const;
+    glm::mat4 getModel(int chunk) const;
+
+    size_t getNumSlots() const;
+    // number of chunks baked so far, counting re-bakes
+    size_t getNumBaked() const;
+};
@@ -0,0 +1,174 @@
+#include "jobs.h"
+
+#include <algorithm>
+
+namespace {
+    // index of the worker the current thread is, if any
+    thread_local size_t currentWorker = 0;
+}
+
+// class ph::jobs::Scheduler
+ph::jobs::Scheduler::Scheduler(unsigned numWorkers) {
+    // hardware_concurrency() may return 0 if it can't tell
+    numWorkers = std::max(numWorkers, 1u);
+    for (unsigned i = 0; i < numWorkers; ++i)
+        workers.emplace_back(new Worker);
+
+    currentWorker = 0;
+    for (unsigned i = 1; i < numWorkers; ++i)
+        threads.emplace_back(&Scheduler::workerLoop, this, i);
+}
+ph::jobs::Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running.store(false, std::memory_order_release);
+    }
+    wake.notify_all();
+    for (auto& thread : threads)
+        thread.join();
+}
+unsigned ph::jobs::Scheduler::getNumWorkers() const {
+    return workers.size();
+}
+size_t ph::jobs::Scheduler::getCurrentWorker() {
+    return currentWorker;
+}
+ph::memory::AllocationStats ph::jobs::Scheduler::getWorkerAllocations() const {
+    memory::AllocationStats total{0, 0};
+    for (size_t i = 1; i < workers.size(); ++i) {
+        total.allocations += workers[i]->allocations.load(std::memory_order_relaxed);
+        total.bytes += workers[i]->bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+void ph::jobs::Scheduler::run(Job job, Counter* counter, const Counter* dependency) {
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    if (dependency && !dependency->isDone()) {
+        std::lock_guard<std::mutex> lock(deferredMutex);
+        // recheck now that we hold the lock, as finish() may have just run
+        if (!dependency->isDone()) {
+            deferred.push_back({{std::move(job), counter, nullptr, nullptr, 0, 0}, dependency});
+            return;
+        }
+    }
+    push({std::move(job), counter, nullptr, nullptr, 0, 0});
+}
+void ph::jobs::Scheduler::push(Task task) {
+    auto& worker = *workers[currentWorker];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    {
+        // taking the lock orders this against a worker about to sleep
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+bool ph::jobs::Scheduler::runOne() {
+    const size_t self = currentWorker;
+    Task task;
+    bool found = false;
+
+    // newest job from our own deque
+    {
+        auto& worker = *workers[self];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.empty()) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            worker.reset();
+            found = true;
+        }
+    }
+    // otherwise the oldest job of another worker
+    for (size_t i = 1; !found && i < workers.size(); ++i) {
+        auto& victim = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.empty()) {
+            task = std::move(victim.tasks[victim.front++]);
+            victim.reset();
+            found = true;
+        }
+    }
+    if (!found)
+        return false;
+
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    if (task.range)
+        task.range(task.body, task.first, task.last);
+    else
+        task.job();
+    // publish before finishing, so whoever waits on the counter sees the counts
+    if (self != 0) {
+        const auto stats = memory::getThreadAllocations();
+        workers[self]->allocations.store(stats.allocations, std::memory_order_relaxed);
+        workers[self]->bytes.store(stats.bytes, std::memory_order_relaxed);
+    }
+    finish(task.counter);
+    return true;
+}
+void ph::jobs::Scheduler::finish(Counter* counter) {
+    if (!counter || counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    // the counter reached zero: release the jobs that were waiting on it
+    std::vector<Task> ready;
+    {
+        std::lock_guard<std::mutex> lock(deferredMutex);
+        const auto firstReady = std::partition(deferred.begin(), deferred.end(), [](const Deferred& d) {
+            return !d.dependency->isDone();
+        });
+        for (auto it = firstReady; it != deferred.end(); ++it)
+            ready.push_back(std::move(it->task));
+        deferred.erase(firstReady, deferred.end());
+    }
+    for (auto& task : ready)
+        push(std::move(task));
+}
+void ph::jobs::Scheduler::workerLoop(const size_t index) {
+    currentWorker = index;
+    while (running.load(std::memory_order_acquire)) {
+        if (runOne())
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] {
+            return !running.load(std::memory_order_acquire) || queued.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
+void ph::jobs::Scheduler::wait(const Counter& counter) {
+    while (!counter.isDone()) {
+        // help out instead of blocking; if there is nothing to run, the
+        // remaining jobs are in flight on other workers
+        if (!runOne())
+            std::this_thread::yield();
+    }
+}
+void ph::jobs::Scheduler::parallelFor(const size_t begin, const size_t end, size_t grain, const void* body,
+                                      const RangeThunk range) {
+    grain = std::max<size_t>(grain, 1);
+    Counter counter;
+    for (size_t first = begin; first < end; first += grain) {
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        push({Job{}, &counter, body, range, first, std::min(first + grain, end)});
+    }
+    wait(counter);
+}
+void ph::jobs::Scheduler::runOnMainThread(Job job) {
+    std::lock_guard<std::mutex> lock(mainMutex);
+    mainQueue.push_back(std::move(job));
+}
+void ph::jobs::Scheduler::pumpMainThread() {
+    {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainRunning.swap(mainQueue);
+    }
+    // jobs queued while these run wait for the next pump
+    for (auto& job : mainRunning)
+        job();
+    mainRunning.clear();
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "memory.h"
+
+namespace ph {
+    namespace jobs {
+        // Counts the unfinished jobs of a group. Pass it to Scheduler::run()
+        // for each job in the group, then wait on it or make other jobs
+        // depend on it.
+        class Counter {
+            std::atomic<int> pending{0};
+            friend class Scheduler;
+
+        public:
+            bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+        };
+
+        // Work-stealing job scheduler.
+        //
+        // Every worker owns a deque of jobs. A worker pushes and pops jobs at
+        // the back of its own deque (so recently spawned, cache-warm work runs
+        // first) and, when it runs dry, steals from the front of the others'.
+        // The thread that creates the scheduler is worker 0: it runs jobs
+        // while it waits on a counter, and it alone drains the main-thread
+        // queue, which is where anything touching the GL context must go.
+        class Scheduler {
+            using Job = std::function<void()>;
+            // calls a parallelFor() body, given to it as body
+            using RangeThunk = void (*)(const void* body, size_t first, size_t last);
+            // either a job, or a subrange of a parallelFor(), whose body is
+            // kept by pointer so neither the call nor splitting it up allocates
+            struct Task {
+                Job job;
+                Counter* counter;
+                const void* body;
+                RangeThunk range;
+                size_t first, last;
+            };
+            struct Deferred {
+                Task task;
+                const Counter* dependency;
+            };
+            // a deque as a vector with a moving front, so pushing and popping
+            // never allocates once it has grown to the size of the workload
+            struct Worker {
+                std::mutex mutex;
+                std::vector<Task> tasks;
+                size_t front{0};
+                // the worker thread's memory::getThreadAllocations(), as of its last finished job
+                std::atomic<uint64_t> allocations{0};
+                std::atomic<uint64_t> bytes{0};
+
+                bool empty() const { return front == tasks.size(); }
+                void reset() {
+                    if (empty()) {
+                        tasks.clear();
+                        front = 0;
+                    }
+                }
+            };
+
+            std::vector<std::unique_ptr<Worker>> workers;
+            std::vector<std::thread> threads;
+            std::atomic<bool> running{true};
+
+            // idle workers sleep until a job is queued
+            std::atomic<int> queued{0};
+            std::mutex sleepMutex;
+            std::condition_variable wake;
+
+            // jobs waiting on a dependency, rechecked whenever a counter reaches zero
+            std::mutex deferredMutex;
+            std::vector<Deferred> deferred;
+
+            std::mutex mainMutex;
+            std::vector<Job> mainQueue;
+            std::vector<Job> mainRunning;
+
+            void push(Task task);
+            bool runOne();
+            void finish(Counter* counter);
+            void workerLoop(size_t index);
+            void parallelFor(size_t begin, size_t end, size_t grain, const void* body, RangeThunk range);
+
+        public:
+            // numWorkers counts the calling thread, so numWorkers - 1 threads are started
+            explicit Scheduler(unsigned numWorkers = std::thread::hardware_concurrency());
+            ~Scheduler();
+            Scheduler(const Scheduler&) = delete;
+            Scheduler& operator=(const Scheduler&) = delete;
+
+            unsigned getNumWorkers() const;
+            // index of the worker the calling thread is, in [0, getNumWorkers()); 0
+            // for the thread that created the scheduler and for unrelated threads
+            static size_t getCurrentWorker();
+            // heap allocations made so far by the threads the scheduler
+            // started, up to the end of their last finished job; add it to the
+            // calling thread's to count the allocations of parallel work
+            memory::AllocationStats getWorkerAllocations() const;
+
+            // queues a job; counter (optional) is held until it finishes, and
+            // the job does not start before dependency (optional) is done
+            void run(Job job, Counter* counter = nullptr, const Counter* dependency = nullptr);
+            // runs other jobs until counter is done
+            void wait(const Counter& counter);
+
+            // calls body(first, last) for subranges of [begin, end) of at most
+            // grain indices, spread over the workers, and returns when all are done
+            template<typename Body>
+            void parallelFor(size_t begin, size_t end, size_t grain, const Body& body) {
+                parallelFor(begin, end, grain, &body, [](const void* b, const size_t first, const size_t last) {
+                    (*static_cast<const Body*>(b))(first, last);
+                });
+            }
+
+            // queues a job to run on the main thread at the next pumpMainThread()
+            void runOnMainThread(Job job);
+            void pumpMainThread();
+        };
+    }
+}
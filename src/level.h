@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+enum class Tile : uint8_t {
+    DIRT, GRAY_BRICK, WALL_BRICK, WOOD, GOAL
+};
+
+// The tile map is divided into square chunks of CHUNK_SIZE x CHUNK_SIZE
+// tiles (cut short along the far edges), which is the unit it is saved in.
+constexpr int CHUNK_SIZE = 16;
+
+// The tile map, stored row by row.
+struct Level {
+    int width;
+    int height;
+    std::vector<Tile> tiles;
+
+    Level(const int width, const int height, const Tile fill = Tile::DIRT)
+        : width(width), height(height), tiles(width * height, fill) {}
+
+    Tile& at(const int x, const int y) { return tiles[y * width + x]; }
+    Tile at(const int x, const int y) const { return tiles[y * width + x]; }
+
+    int getChunksX() const { return (width + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+    int getChunksY() const { return (height + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+    int getNumChunks() const { return getChunksX() * getChunksY(); }
+
+    // the tiles [x0, x1) x [y0, y1) of a chunk, numbered row by row
+    struct ChunkBounds {
+        int x0, y0, x1, y1;
+    };
+    ChunkBounds getChunkBounds(const int chunk) const {
+        const int x0 = chunk % getChunksX() * CHUNK_SIZE;
+        const int y0 = chunk / getChunksX() * CHUNK_SIZE;
+        return {x0, y0, std::min(x0 + CHUNK_SIZE, width), std::min(y0 + CHUNK_SIZE, height)};
+    }
+};
+
+struct Player {
+    glm::vec3 acceleration{0.0f, 0.0f, 0.0f};
+    glm::vec3 velocity{0.0f, 0.0f, 0.0f};
+    glm::vec3 position{0.0f, 0.0f, 0.0f};
+};
@@ -1,41 +1,60 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
 #include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "audio.h"
+#include "draw.h"
+#include "impostor.h"
+#include "jobs.h"
+#include "level.h"
+#include "memory.h"
+#include "particles.h"
 #include "ph.h"
-
-enum class Tile {
-    DIRT, GRAY_BRICK, WALL_BRICK, WOOD, GOAL
+#include "resolution.h"
+#include "snapshot.h"
+#include "text.h"
+
+// one vertex of the level mesh, laid out as the shader reads it
+struct TileVertex {
+    glm::vec3 position;
+    ph::Normalized<glm::i8vec4> normal;
+    ph::Half2 texCoord;
 };
-
-// returns the posCoords for the specified tile
-std::vector<float> getTilePosCoords(const glm::vec2& tilePos) {
-    return {
-        tilePos.x-0.5f,  tilePos.y-0.5f,  0.5f,   // top left
-        tilePos.x+0.5f,  tilePos.y-0.5f,  0.5f,   // top right
-        tilePos.x+0.5f,  tilePos.y+0.5f,  0.5f,   // bottom right
-        tilePos.x+0.5f,  tilePos.y+0.5f,  0.5f,   // bottom right
-        tilePos.x-0.5f,  tilePos.y+0.5f,  0.5f,   // bottom left
-        tilePos.x-0.5f,  tilePos.y-0.5f,  0.5f,   // top left
+using TileLayout = ph::VertexLayout<TileVertex, PH_ATTRIBUTE(TileVertex, position),
+                                                PH_ATTRIBUTE(TileVertex, normal),
+                                                PH_ATTRIBUTE(TileVertex, texCoord)>;
+constexpr int VERTICES_PER_TILE = 6;
+
+// writes the positions for the specified tile
+void getTilePosCoords(const glm::vec2& tilePos, TileVertex* out) {
+    const glm::vec3 positions[VERTICES_PER_TILE] = {
+        {tilePos.x-0.5f,  tilePos.y-0.5f,  0.5f},   // top left
+        {tilePos.x+0.5f,  tilePos.y-0.5f,  0.5f},   // top right
+        {tilePos.x+0.5f,  tilePos.y+0.5f,  0.5f},   // bottom right
+        {tilePos.x+0.5f,  tilePos.y+0.5f,  0.5f},   // bottom right
+        {tilePos.x-0.5f,  tilePos.y+0.5f,  0.5f},   // bottom left
+        {tilePos.x-0.5f,  tilePos.y-0.5f,  0.5f},   // top left
     };
+    for (int i = 0; i < VERTICES_PER_TILE; ++i)
+        out[i].position = positions[i];
 }
 
-// returns the normalCoords for a tile
-std::vector<float> getTileNormalCoords() {
-    return {
-        0.0f,  0.0f,  1.0f,
-        0.0f,  0.0f,  1.0f,
-        0.0f,  0.0f,  1.0f,
-        0.0f,  0.0f,  1.0f,
-        0.0f,  0.0f,  1.0f,
-        0.0f,  0.0f,  1.0f,
-    };
+// writes the normals for a tile
+void getTileNormalCoords(TileVertex* out) {
+    for (int i = 0; i < VERTICES_PER_TILE; ++i)
+        out[i].normal = glm::i8vec4{0, 0, 127, 0};
 }
 
-// returns the texCoords for the specified tile
-std::vector<float> getTileTexCoords(const Tile t) {
+// writes the texCoords for the specified tile
+void getTileTexCoords(const Tile t, TileVertex* out) {
     const glm::vec2 numTiles{16, 16};                   // number of tiles in the tilemap
     const glm::vec2 tSize{16.0f/256.0f, 16.0f/256.0f};  // tile texture width as a percent of tilemap width
     glm::vec2 tPos;                                         // position of top left
@@ -50,93 +69,284 @@ std::vector<float> getTileTexCoords(const Tile t) {
     case Tile::GOAL:        tPos = glm::vec2{4, numTiles.y-1} * tSize;     break;
     };
 
-    return {
-        tPos.x+0.0f,      tPos.y+0.0f,
-        tPos.x+tSize.x,   tPos.y+0.0f,
-        tPos.x+tSize.x,   tPos.y+tSize.y,
-        tPos.x+tSize.x,   tPos.y+tSize.y,
-        tPos.x+0.0f,      tPos.y+tSize.y,
-        tPos.x+0.0f,      tPos.y+0.0f,
+    // multiples of 1/256 are exact in half precision
+    const glm::vec2 texCoords[VERTICES_PER_TILE] = {
+        {tPos.x+0.0f,      tPos.y+0.0f},
+        {tPos.x+tSize.x,   tPos.y+0.0f},
+        {tPos.x+tSize.x,   tPos.y+tSize.y},
+        {tPos.x+tSize.x,   tPos.y+tSize.y},
+        {tPos.x+0.0f,      tPos.y+tSize.y},
+        {tPos.x+0.0f,      tPos.y+0.0f},
     };
+    for (int i = 0; i < VERTICES_PER_TILE; ++i)
+        out[i].texCoord = ph::Half2{texCoords[i]};
+}
+
+size_t getNumLevelVertices(const Level& level) {
+    return level.width * level.height * VERTICES_PER_TILE;
+}
+
+// returns the index of the first vertex of a chunk in the level mesh
+size_t getChunkFirstVertex(const Level& level, const Level::ChunkBounds& b) {
+    // skip the rows of chunks above, then the chunks to the left in this row
+    return (b.y0 * level.width + b.x0 * (b.y1 - b.y0)) * VERTICES_PER_TILE;
+}
+
+// returns the number of vertices of a chunk in the level mesh
+size_t getChunkNumVertices(const Level::ChunkBounds& b) {
+    return (b.x1 - b.x0) * (b.y1 - b.y0) * VERTICES_PER_TILE;
 }
 
-ph::VertexArray createVA(const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<float>& texCoords) {
-    constexpr int dimPosition = 3;
-    constexpr int dimNormal = 3;
-    constexpr int dimTexCoords = 2;
-    constexpr int dimVertex = dimPosition + dimNormal + dimTexCoords;
-
-    const auto count = positions.size() / dimPosition;
-
-    std::vector<float> vertices;
-    vertices.reserve(dimVertex * count);
-    for (size_t i=0; i < count; ++i) {
-        // position (posCoords)
-        vertices.push_back(positions[i*dimPosition + 0]);
-        vertices.push_back(positions[i*dimPosition + 1]);
-        vertices.push_back(positions[i*dimPosition + 2]);
-
-        // normal (normalCoords)
-        vertices.push_back(normals[i*dimNormal + 0]);
-        vertices.push_back(normals[i*dimNormal + 1]);
-        vertices.push_back(normals[i*dimNormal + 2]);
-
-        // texCoords
-        vertices.push_back(texCoords[i*dimTexCoords + 0]);
-        vertices.push_back(texCoords[i*dimTexCoords + 1]);
+// returns the getNumLevelVertices() vertices of the level mesh, stored chunk
+// by chunk in scratch memory from the arena. Every chunk fills its own slice
+// of the buffer, so chunks are built in parallel.
+TileVertex* buildLevelVertices(const Level& level, ph::jobs::Scheduler& scheduler, ph::memory::Arena& arena) {
+    TileVertex* vertices = arena.allocate<TileVertex>(getNumLevelVertices(level));
+
+    scheduler.parallelFor(0, level.getNumChunks(), 1, [&](const size_t first, const size_t last) {
+        for (size_t chunk = first; chunk < last; ++chunk) {
+            const auto b = level.getChunkBounds(chunk);
+            TileVertex* out = vertices + getChunkFirstVertex(level, b);
+
+            for (int y = b.y0; y < b.y1; ++y) {
+                for (int x = b.x0; x < b.x1; ++x) {
+                    getTilePosCoords({x, y}, out);
+                    getTileNormalCoords(out);
+                    getTileTexCoords(level.at(x, y), out);
+                    out += VERTICES_PER_TILE;
+                }
+            }
+        }
+    });
+    return vertices;
+}
+
+// Encodes a run of snapshots of a large level that changes a little every
+// step, as the recorder would, then decodes them all again and prints the
+// throughput of keyframes and deltas.
+void benchmarkSnapshots() {
+    constexpr int MAP_SIZE = 1024;
+    constexpr int NUM_SNAPSHOTS = 64;
+    constexpr int KEYFRAME_INTERVAL = 16;
+    constexpr int EDITS_PER_SNAPSHOT = 256;
+    using Clock = std::chrono::steady_clock;
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    // xorshift32, so every run edits the same tiles
+    uint32_t random = 0x9e3779b9u;
+    const auto nextRandom = [&random] {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        return random;
+    };
+    Level level{MAP_SIZE, MAP_SIZE};
+    for (auto& tile : level.tiles)
+        tile = static_cast<Tile>(nextRandom() % 8 < 6 ? 0 : nextRandom() % 5);
+    Player player;
+
+    // ENCODE
+    // index 0 is keyframes, 1 deltas
+    struct Totals {
+        int count;
+        size_t bytes;
+        Milliseconds encodeTime, decodeTime;
+    } totals[2]{};
+    std::vector<std::vector<uint8_t>> snapshots(NUM_SNAPSHOTS);
+    Level previous{0, 0};
+    for (int i = 0; i < NUM_SNAPSHOTS; ++i) {
+        // edits cluster in a few places, like a player building or digging
+        const int cx = nextRandom() % (MAP_SIZE - 64), cy = nextRandom() % (MAP_SIZE - 64);
+        for (int e = 0; e < EDITS_PER_SNAPSHOT; ++e)
+            level.at(cx + nextRandom() % 64, cy + nextRandom() % 64) = static_cast<Tile>(nextRandom() % 5);
+        player.position.x = static_cast<float>(i);
+
+        const bool keyframe = i % KEYFRAME_INTERVAL == 0;
+        const auto start = Clock::now();
+        snapshot::encode(level, player, keyframe ? nullptr : &previous, i, snapshots[i]);
+        auto& total = totals[keyframe ? 0 : 1];
+        total.encodeTime += Clock::now() - start;
+        total.bytes += snapshots[i].size();
+        ++total.count;
+        previous = level;
     }
 
-    return ph::VertexArray(vertices.data(), count*dimVertex, {dimPosition, dimNormal, dimTexCoords});
+    // DECODE
+    Level restored{0, 0};
+    Player restoredPlayer;
+    for (int i = 0; i < NUM_SNAPSHOTS; ++i) {
+        const auto start = Clock::now();
+        const bool decoded = snapshot::decode(snapshots[i].data(), snapshots[i].size(), restored, restoredPlayer);
+        totals[i % KEYFRAME_INTERVAL == 0 ? 0 : 1].decodeTime += Clock::now() - start;
+        if (!decoded) {
+            std::cerr << "Error: Snapshot " << i << " failed to decode!\n";
+            return;
+        }
+    }
+    if (restored.tiles != level.tiles || restoredPlayer.position != player.position)
+        std::cerr << "Error: Decoded snapshots do not match the level!\n";
+
+    std::cout << "Snapshots of a " << MAP_SIZE << "x" << MAP_SIZE << " level, "
+              << EDITS_PER_SNAPSHOT << " tile edits apart:\n";
+    const char* names[2] = {"keyframes", "deltas"};
+    for (int k = 0; k < 2; ++k) {
+        const auto& total = totals[k];
+        std::cout << "  " << total.count << " " << names[k] << ": " << total.bytes / total.count << " bytes, "
+                  << total.encodeTime.count() / total.count << " ms to save ("
+                  << total.bytes / total.encodeTime.count() << " bytes/ms), "
+                  << total.decodeTime.count() / total.count << " ms to restore ("
+                  << total.bytes / total.decodeTime.count() << " bytes/ms)\n";
+    }
+}
+
+// Builds the mesh of a large level on 1 to maxWorkers workers, a few times
+// each, and prints the best and median times and the speedup over one worker.
+void benchmarkLevelBuild(const unsigned maxWorkers) {
+    constexpr int MAP_SIZE = 512;
+    constexpr int NUM_RUNS = 7;
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    Level level{MAP_SIZE, MAP_SIZE};
+    for (int i = 0; i < MAP_SIZE * MAP_SIZE; ++i)
+        level.tiles[i] = static_cast<Tile>(i * 7 % 5);
+    ph::memory::Arena arena{getNumLevelVertices(level) * sizeof(TileVertex)};
+
+    std::cout << "Level mesh of a " << MAP_SIZE << "x" << MAP_SIZE << " level, best of " << NUM_RUNS << ":\n"
+              << "  workers   best ms   median ms   speedup\n";
+    double baseline = 0.0;
+    for (unsigned workers = 1; workers <= maxWorkers; ++workers) {
+        ph::jobs::Scheduler scheduler{workers};
+        // one run to start the threads and fault the arena's pages in
+        buildLevelVertices(level, scheduler, arena);
+        arena.reset();
+
+        double times[NUM_RUNS];
+        for (auto& time : times) {
+            const auto start = std::chrono::steady_clock::now();
+            buildLevelVertices(level, scheduler, arena);
+            time = Milliseconds{std::chrono::steady_clock::now() - start}.count();
+            arena.reset();
+        }
+        std::sort(times, times + NUM_RUNS);
+        if (workers == 1)
+            baseline = times[0];
+        std::printf("  %7u %9.2f %11.2f %8.2fx\n", workers, times[0], times[NUM_RUNS / 2], baseline / times[0]);
+    }
+}
+
+// Streams looping voices from the archive into an unpaced null backend for
+// a second, so the mixer runs flat out, and prints its throughput.
+void benchmarkMixer(const ph::Archive& archive) {
+    constexpr int NUM_VOICES = 16;
+    constexpr int SAMPLE_RATE = 44100;
+    const auto entry = archive.find("sound/test.ogg");
+    if (!entry) {
+        std::cerr << "Error: Failed to find sound/test.ogg!\n";
+        return;
+    }
+
+    ph::audio::Mixer mixer{std::unique_ptr<ph::audio::Backend>{new ph::audio::NullBackend{SAMPLE_RATE, false}}};
+    for (int i = 0; i < NUM_VOICES; ++i)
+        mixer.play(archive.getData(*entry), entry->size, 1.0f / NUM_VOICES, true);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    // a voice block is BLOCK_FRAMES frames of one voice
+    const double voicesPerMs = mixer.getVoicesMixedPerMs();
+    std::cout << "Mixer: " << voicesPerMs << " voice blocks/ms with " << NUM_VOICES << " voices, enough for "
+              << voicesPerMs * ph::audio::BLOCK_FRAMES / (SAMPLE_RATE / 1000.0) << " voices in real time\n";
+}
+
+// Keeps a full particle simulation going for a few simulated seconds, once
+// with SSE and once without, refilling what dies each frame, and prints the
+// throughput of emitting and updating separately.
+void benchmarkParticles() {
+    constexpr size_t NUM_PARTICLES = 1 << 18;
+    constexpr int NUM_FRAMES = 300;
+    constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+    ph::ParticleEmitter emitter;
+    emitter.velocity = {0.0f, 0.0f, 2.0f};
+    emitter.spread = 1.0f;
+    emitter.acceleration = {0.0f, 0.0f, -9.81f};
+    emitter.minLifetime = 0.5f;
+    emitter.maxLifetime = 2.0f;
+
+    std::cout << "Particles, " << NUM_PARTICLES << " for " << NUM_FRAMES << " frames:\n"
+              << "           emitted/ms   updated/ms\n";
+    double scalarUpdated = 0.0;
+    for (const bool vectorized : {false, true}) {
+        ph::ParticleSimulation particles{NUM_PARTICLES};
+        particles.setVectorized(vectorized);
+        if (particles.isVectorized() != vectorized)
+            continue;       // no SSE in this build
+        particles.setDrag(0.5f);
+        for (int frame = 0; frame < NUM_FRAMES; ++frame) {
+            particles.emit(emitter, particles.getCapacity() - particles.getCount());
+            particles.update(DELTA_TIME);
+        }
+        if (!vectorized)
+            scalarUpdated = particles.getUpdatedPerMs();
+        std::printf("  %-6s %12.0f %12.0f", vectorized ? "SSE" : "scalar", particles.getEmittedPerMs(),
+                    particles.getUpdatedPerMs());
+        if (vectorized && scalarUpdated > 0.0)
+            std::printf("   %.2fx", particles.getUpdatedPerMs() / scalarUpdated);
+        std::printf("\n");
+    }
 }
 
 int main() {
     using namespace ph;
 
+    // PH_NUM_WORKERS overrides the worker count, which is also the most
+    // workers the level build benchmark scales up to
+    const char* numWorkers = std::getenv("PH_NUM_WORKERS");
+    const unsigned maxWorkers = numWorkers ? static_cast<unsigned>(std::atoi(numWorkers))
+                                           : std::thread::hardware_concurrency();
+
+    // PH_BENCHMARK runs the benchmarks instead of the game
+    if (std::getenv("PH_BENCHMARK")) {
+        benchmarkSnapshots();
+        benchmarkLevelBuild(std::max(maxWorkers, 1u));
+        benchmarkMixer(Archive{"resources.pak"});
+        benchmarkParticles();
+        return EXIT_SUCCESS;
+    }
+
     constexpr int WIDTH = 1280;
     constexpr int HEIGHT = 720;
     const Window window{WIDTH, HEIGHT};
+    const Archive resources{"resources.pak"};
+
+    jobs::Scheduler scheduler{maxWorkers};
 
     //  LEVEL MODEL INITIALIZATION
     //-------------------------------
     // LEVEL DATA
     constexpr int MAP_SIZE_X = 100;
     constexpr int MAP_SIZE_Y = 100;
-    constexpr int NUM_TILES = MAP_SIZE_X * MAP_SIZE_Y;
 
-    Tile map[NUM_TILES];
-    for (auto& t : map) {
-        t = Tile::DIRT;
-    }
-    map[0 * MAP_SIZE_X + 1] = Tile::GRAY_BRICK; // (1, 0)
-    map[1 * MAP_SIZE_X + 0] = Tile::WALL_BRICK; // (0, 1)
-
-    // LEVEL GEOMETRY DATA
-    // level normals
-    std::vector<float> levelNormals;
-    levelNormals.reserve(NUM_TILES * 6 * 3);    // 6 vertices per tile, 3 normalCoords per vertex
-
-    const auto tileNormals = getTileNormalCoords();
-    for (int i=0; i<NUM_TILES; ++i) {
-        levelNormals.insert(levelNormals.end(), tileNormals.begin(), tileNormals.end());
-    }
-
-    // level positions and texCoords
-    std::vector<float> levelPositions, levelTexCoords;
-    levelPositions.reserve(NUM_TILES * 6 * 3);  // 6 vertices per tile, 3 posCoords per vertex
-    levelTexCoords.reserve(NUM_TILES * 6 * 2);  // 6 vertices per tile, 2 texCoords per vertex
-    for (int y=0; y<MAP_SIZE_Y; ++y) {
-        for (int x=0; x<MAP_SIZE_X; ++x) {
-            auto tilePositions = getTilePosCoords({x, y});
-            levelPositions.insert(levelPositions.end(), tilePositions.begin(), tilePositions.end());
-
-            auto tileTexCoords = getTileTexCoords(map[y * MAP_SIZE_X + x]);
-            levelTexCoords.insert(levelTexCoords.end(), tileTexCoords.begin(), tileTexCoords.end());
-        }
-    }
-
-    const VertexArray levelVA = createVA(levelPositions, levelNormals, levelTexCoords);
-    const Texture levelTexture{"resources/textures/tilemap.png"};
-    const Shader levelShader{"resources/shaders/basic.vert", "resources/shaders/basic.frag"};
+    Level level{MAP_SIZE_X, MAP_SIZE_Y};
+    level.at(1, 0) = Tile::GRAY_BRICK;
+    level.at(0, 1) = Tile::WALL_BRICK;
+
+    // scratch memory for data that only lives for one frame, such as a level
+    // mesh on its way to the GPU; it is reset at the end of every frame
+    memory::Arena frameArena{getNumLevelVertices(level) * sizeof(TileVertex)};
+
+    const auto meshStart = std::chrono::steady_clock::now();
+    const auto levelVertices = buildLevelVertices(level, scheduler, frameArena);
+    const std::chrono::duration<double, std::milli> meshTime = std::chrono::steady_clock::now() - meshStart;
+    std::cout << "Built level mesh in " << meshTime.count() << " ms on "
+              << scheduler.getNumWorkers() << " workers\n";
+    VertexArray levelVA{TileLayout{}, levelVertices, getNumLevelVertices(level)};
+    frameArena.reset();
+    const Texture levelTexture{resources, "textures/tilemap.png"};
+    const Shader levelShader{resources, "shaders/basic.vert", "shaders/basic.frag"};
+
+    // LEVEL LOD
+    // above this camera height chunks are drawn as one quad each
+    constexpr float impostorHeight = 24.0f;
+    ChunkImpostors impostors{resources, level, 64, impostorHeight};
 
     //  LAMP MODEL INITIALIZATION
     //-------------------------------
@@ -189,8 +399,8 @@ int main() {
     };
 
     const VertexArray lampVA{vertices, sizeof(vertices)/sizeof(float), {3, 3, 2}};
-    const Texture lampTexture{"resources/textures/lamp.png"};
-    const Shader lampShader{"resources/shaders/basic.vert", "resources/shaders/lamp.frag"};
+    const Texture lampTexture{resources, "textures/lamp.png"};
+    const Shader lampShader{resources, "shaders/basic.vert", "shaders/lamp.frag"};
     //-------------------------------
 
     // SHADER DATA
@@ -199,8 +409,6 @@ int main() {
     // setting any uniforms in the shader.
     gl::bind(levelTexture);
     gl::setUniform(levelShader, "uTexture", 0);
-    gl::setUniform(levelShader, "uLamp.color", glm::vec3(1.0f, 1.0f, 1.0f));
-    gl::setUniform(levelShader, "uLamp.attenuation", glm::vec3(1.0f, 0.0f, 0.0075f));
 
     // lighting object (lamp) shader
     gl::bind(lampShader);
@@ -217,28 +425,132 @@ int main() {
     const glm::vec3 cameraTarget{0.0f, 0.0f, 0.0f};
     Camera camera{cameraPos, cameraTarget};
 
-    const auto projection = glm::perspective(glm::radians(45.0f), WIDTH/static_cast<float>(HEIGHT), 0.1f, 100.0f);
-    gl::bind(levelShader);
-    gl::setUniform(levelShader, "uProjection", projection);
-    gl::bind(lampShader);
-    gl::setUniform(lampShader, "uProjection", projection);
+    // the projection follows the window's aspect ratio, so it is worked out every frame
+    const auto perspective = [](const glm::ivec2& size) {
+        return glm::perspective(glm::radians(45.0f), size.x/static_cast<float>(size.y), 0.1f, 100.0f);
+    };
 
     const glm::vec3 xHat{1.0f, 0.0f, 0.0f};
     const glm::vec3 yHat{0.0f, 1.0f, 0.0f};
     const glm::vec3 zHat{0.0f, 0.0f, 1.0f};
 
+    //  HUD INITIALIZATION
+    //-------------------------------
+    TextRenderer hud{resources, "textures/font.png", "shaders/text.vert", "shaders/text.frag", WIDTH, HEIGHT};
+    constexpr float hudScale = 2.0f;
+    constexpr float hudLine = TextRenderer::GLYPH_HEIGHT * hudScale;
+    constexpr float hudValueX = 8.0f + 4 * TextRenderer::GLYPH_WIDTH * hudScale;
+    const auto fpsLabel = hud.cache("FPS", {8.0f, 8.0f}, hudScale);
+    const auto frameTimeLabel = hud.cache("ms", {8.0f, 8.0f + hudLine}, hudScale);
+    const auto allocationsLabel = hud.cache("alloc", {8.0f, 8.0f + 2 * hudLine}, hudScale);
+    const auto resolutionLabel = hud.cache("res", {8.0f, 8.0f + 3 * hudLine}, hudScale);
+
+    // frame statistics are averaged over a short interval so the numbers are readable
+    constexpr float hudInterval = 0.5f;
+    float hudTime = 0.0f;
+    int hudFrames = 0;
+    char fpsText[16] = "";
+    char frameTimeText[16] = "";
+    char allocationsText[16] = "";
+    char resolutionText[16] = "";
+
+    // ALLOCATION TRACKING
+    // The HUD shows the heap allocations of the last frame on this thread and
+    // in the jobs it handed to the scheduler's workers, which should be zero once the game has warmed up. With PH_STRICT_ALLOCATIONS
+    // set, every frame after the warm-up that allocates is reported.
+    const bool strictAllocations = std::getenv("PH_STRICT_ALLOCATIONS") != nullptr;
+    constexpr float warmUpTime = 2.0f;
+    memory::AllocationStats frameAllocations{0, 0};
+
+    // DYNAMIC RESOLUTION
+    // The scene is rendered offscreen at whatever fraction of the window's
+    // resolution keeps its GPU time at the target, and upscaled; the HUD is
+    // drawn on top at full resolution. PH_TARGET_FRAME_MS overrides the
+    // target, e.g. to watch the scale drop.
+    const char* targetFrameMs = std::getenv("PH_TARGET_FRAME_MS");
+    DynamicResolution resolution{resources, window.getFramebufferSize(),
+                                 targetFrameMs ? static_cast<float>(std::atof(targetFrameMs)) : 1000.0f / 60.0f};
+
+    // DRAW LISTS
+    // what to draw is decided on the workers; only submitting touches GL
+    DrawLists drawLists{scheduler};
+    const Light lampLight{{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 0.0f, 0.0075f}};
+
+    // PARTICLES
+    // embers rise from the lamp and the player leaves a trail; K sets off a
+    // burst like a guard's death, which plays the frames of its animation
+    ParticleSystem sparks{resources, "textures/projectile.png", 1 << 16};
+    sparks.setDrag(0.5f);
+    ParticleSystem bursts{resources, "textures/animation/death.png", 1 << 18, {6, 6}, 6};
+    bursts.setDrag(2.0f);
+
+    ParticleEmitter embers;
+    embers.velocity = {0.0f, 0.0f, 0.5f};
+    embers.spread = 0.3f;
+    embers.acceleration = {0.0f, 0.0f, 0.8f};
+    embers.minLifetime = 0.5f;
+    embers.maxLifetime = 1.5f;
+    embers.size = 0.05f;
+    embers.color = {255, 160, 64, 255};
+    ParticleEmitter trail;
+    trail.spread = 0.2f;
+    trail.minLifetime = 0.2f;
+    trail.maxLifetime = 0.4f;
+    trail.size = 0.08f;
+    trail.color = {255, 255, 200, 192};
+    ParticleEmitter burst;
+    burst.spread = 6.0f;
+    burst.minLifetime = 0.4f;
+    burst.maxLifetime = 0.8f;
+    burst.size = 0.3f;
+
+    constexpr float emberRate = 200.0f;     // particles per second
+    constexpr float trailRate = 400.0f;
+    constexpr size_t burstSize = 20000;
+    float emberBacklog = 0.0f, trailBacklog = 0.0f;
+    bool wasBursting = false;
+
     // PLAYER DATA
-    struct Player {
-        glm::vec3 acceleration{0.0f, 0.0f, 0.0f};
-        glm::vec3 velocity{0.0f, 0.0f, 0.0f};
-        glm::vec3 position{0.0f, 0.0f, 0.0f};
-    } player;
+    Player player;
+
+    // SNAPSHOTS
+    // the last minute of play is kept for rewinding; F5 quick-saves, F9 quick-loads
+    constexpr float snapshotInterval = 0.25f;
+    const std::string quickSavePath = "quicksave.snap";
+    SnapshotRecorder snapshots{240};
+    float snapshotTime = 0.0f;
+    bool wasSaving = false, wasLoading = false;
+    // restored state is decoded here first, so a failed or mismatched
+    // restore leaves the level and player as they were
+    Level restored{0, 0};
+    Player restoredPlayer;
+    const auto applyRestored = [&] {
+        player = restoredPlayer;
+        if (restored.tiles != level.tiles) {
+            // impostors of the chunks that changed have to be baked again
+            for (int chunk = 0; chunk < level.getNumChunks(); ++chunk) {
+                const auto b = level.getChunkBounds(chunk);
+                for (int y = b.y0; y < b.y1; ++y) {
+                    const auto row = level.tiles.begin() + y * level.width;
+                    if (!std::equal(row + b.x0, row + b.x1, restored.tiles.begin() + y * level.width + b.x0)) {
+                        impostors.markDirty(chunk);
+                        break;
+                    }
+                }
+            }
+            level.tiles = restored.tiles;
+            const auto vertices = buildLevelVertices(level, scheduler, frameArena);
+            levelVA.update(vertices, getNumLevelVertices(level));
+        }
+    };
 
     //  GAME LOOP
     //-------------------------------
+    glm::ivec2 framebufferSize = window.getFramebufferSize();
     float deltaTime = 0.0f;
     float lastFrame = 0.0f;
     while (window.isOpen()) {
+        const auto frameStart = memory::getThreadAllocations() + scheduler.getWorkerAllocations();
         if (window.isKeyPressed(input::Key::Escape))
             window.setShouldClose(true);
 
@@ -276,6 +588,33 @@ int main() {
         // integrate velocity
         player.position += player.velocity * deltaTime;
 
+        // SNAPSHOTS
+        // hold R to rewind, one snapshot per interval
+        snapshotTime += deltaTime;
+        if (snapshotTime >= snapshotInterval) {
+            snapshotTime = 0.0f;
+            const size_t history = snapshots.getHistorySize();
+            if (window.isKeyPressed(input::Key::R)) {
+                if (history > 1 && snapshots.rewind(history - 2, restored, restoredPlayer) &&
+                    restored.width == level.width && restored.height == level.height)
+                    applyRestored();
+            } else {
+                snapshots.capture(level, player);
+            }
+        }
+        const bool saving = window.isKeyPressed(input::Key::F5);
+        if (saving && !wasSaving)
+            snapshots.save(level, player, quickSavePath);
+        wasSaving = saving;
+        const bool loading = window.isKeyPressed(input::Key::F9);
+        if (loading && !wasLoading) {
+            snapshots.flush();      // let a quick-save still in flight finish first
+            if (snapshot::load(quickSavePath, restored, restoredPlayer) && restored.width == level.width &&
+                restored.height == level.height)
+                applyRestored();
+        }
+        wasLoading = loading;
+
         // update camera motion
         constexpr float cameraSpeed = 8.0f;
         if (window.isKeyPressed(input::Key::Space))
@@ -287,44 +626,147 @@ int main() {
         camera.target = player.position + 0.1f * player.velocity;
         const auto lampPosition = glm::vec3{1.0f, 1.0f, 0.25f} * camera.position;
 
+        // UPDATE PARTICLES
+        // continuous emitters carry the fractional particles over to the next frame
+        embers.position = lampPosition;
+        emberBacklog += emberRate * deltaTime;
+        emberBacklog -= sparks.emit(embers, static_cast<size_t>(emberBacklog));
+        if (glm::length(player.velocity) > 1.0f) {
+            trail.position = player.position;
+            trail.velocity = -0.25f * player.velocity;
+            trailBacklog += trailRate * deltaTime;
+            trailBacklog -= sparks.emit(trail, static_cast<size_t>(trailBacklog));
+        }
+        const bool bursting = window.isKeyPressed(input::Key::K);
+        if (bursting && !wasBursting) {
+            burst.position = player.position;
+            bursts.emit(burst, burstSize);
+        }
+        wasBursting = bursting;
+        sparks.update(deltaTime);
+        bursts.update(deltaTime);
+
+        // run what the workers handed back to the GL thread, e.g. uploads
+        scheduler.pumpMainThread();
+
         //  RENDER
         //-------------------------------
+        // bake the impostors that were missing last frame
+        const bool useImpostors = impostors.isActive(camera.position.z);
+        if (useImpostors) {
+            impostors.update(levelTexture, [&](const int chunk) {
+                const auto b = level.getChunkBounds(chunk);
+                gl::bind(levelVA);
+                gl::draw(levelVA, getChunkFirstVertex(level, b), getChunkNumVertices(b));
+            });
+        }
+
+        // a minimized window has no pixels to draw into; keep the last size then
+        const glm::ivec2 windowSize = window.getFramebufferSize();
+        if (windowSize.x > 0 && windowSize.y > 0)
+            framebufferSize = windowSize;
+        resolution.begin(framebufferSize);
         gl::clear(0.0f, 0.05f, 0.1f, 1.0f);
 
         // The data flow for rendering is as follows:
-        //  1)  Bind textures
-        //  2)  Bind shader program
-        //  5)  Bind the vertex array  (i.e. pass the vertex data to the GPU)
-        //  4)  Set shader uniforms (any that changed between last render and now)
-        //  6)  Draw the object to the screen.
-
-        // DRAW LEVEL MODEL
-        gl::bind(levelTexture);
-        gl::bind(levelShader);
-        gl::bind(levelVA);
+        //  1)  Record draws into the workers' command lists (culling, sorting
+        //      keys and uniform values are worked out here, off the GL thread)
+        //  2)  Submit: sort each list on the workers, then merge them on this
+        //      thread while binding textures, shader programs and vertex
+        //      arrays, setting uniforms and drawing
 
         const auto view = camera.viewMatrix();
-        gl::setUniform(levelShader, "uView", view);
-        gl::setUniform(levelShader, "uModel", glm::mat4{1.0f});
-        gl::setUniform(levelShader, "uLamp.position", lampPosition);
-
-        gl::draw(levelVA);
-
-        // DRAW LAMP
-        gl::bind(lampTexture);
-        gl::bind(lampShader);
-        gl::bind(lampVA);
-
-        gl::setUniform(lampShader, "uView", view);
-        auto lampModel = glm::mat4(1.0f);
-        lampModel = glm::translate(lampModel, lampPosition);
-        gl::setUniform(lampShader, "uModel", lampModel);
-
-        gl::draw(lampVA);
+        const auto projection = perspective(framebufferSize);
+        drawLists.begin(view, projection);
+
+        // RECORD
+        // Chunks outside the view frustum are culled; each chunk is one range
+        // of the level mesh. The item after the last chunk is the lamp.
+        const size_t numChunks = level.getNumChunks();
+        scheduler.parallelFor(0, numChunks + 1, 4, [&](const size_t first, const size_t last) {
+            auto& list = drawLists.getList();
+            for (size_t chunk = first; chunk < std::min(last, numChunks); ++chunk) {
+                const auto b = level.getChunkBounds(chunk);
+                const glm::vec3 min{b.x0 - 0.5f, b.y0 - 0.5f, 0.5f};
+                const glm::vec3 max{b.x1 - 0.5f, b.y1 - 0.5f, 0.5f};
+                if (!drawLists.getFrustum().intersects(min, max))
+                    continue;
+                const float depth = drawLists.getDepth(0.5f * (min + max));
+                // chunks without an impostor yet are drawn in full until it is baked
+                const int slot = useImpostors ? impostors.acquire(chunk) : -1;
+                if (slot >= 0) {
+                    list.draw(levelShader, impostors.getTexture(), impostors.getVertexArray(),
+                              impostors.getFirstVertex(slot), ChunkImpostors::VERTICES_PER_QUAD,
+                              impostors.getModel(chunk), depth);
+                } else {
+                    list.draw(levelShader, levelTexture, levelVA, getChunkFirstVertex(level, b),
+                              getChunkNumVertices(b), glm::mat4{1.0f}, depth);
+                }
+            }
+            if (last > numChunks) {
+                Light light = lampLight;
+                light.position = lampPosition;
+                list.addLight(light);
+                const auto lampModel = glm::translate(glm::mat4(1.0f), lampPosition);
+                list.draw(lampShader, lampTexture, lampVA, 0, lampVA.getCount(), lampModel,
+                          drawLists.getDepth(lampPosition));
+            }
+        });
+
+        // SUBMIT
+        drawLists.submit();
+
+        // DRAW PARTICLES
+        sparks.draw(view, projection);
+        bursts.draw(view, projection);
+
+        // UPSCALE
+        resolution.end();
+
+        // DRAW HUD
+        hudTime += deltaTime;
+        ++hudFrames;
+        if (hudTime >= hudInterval) {
+            std::snprintf(fpsText, sizeof(fpsText), "%.0f", hudFrames / hudTime);
+            std::snprintf(frameTimeText, sizeof(frameTimeText), "%.2f", 1000.0f * hudTime / hudFrames);
+            std::snprintf(allocationsText, sizeof(allocationsText), "%llu",
+                          static_cast<unsigned long long>(frameAllocations.allocations));
+            // in percent of the window's resolution per axis; the font has no % sign
+            std::snprintf(resolutionText, sizeof(resolutionText), "%.0f", 100.0f * resolution.getScale());
+            hudTime = 0.0f;
+            hudFrames = 0;
+        }
+        hud.add(fpsLabel);
+        hud.add(fpsText, {hudValueX, 8.0f}, hudScale);
+        hud.add(frameTimeLabel);
+        hud.add(frameTimeText, {hudValueX, 8.0f + hudLine}, hudScale);
+        hud.add(allocationsLabel);
+        hud.add(allocationsText, {hudValueX, 8.0f + 2 * hudLine}, hudScale);
+        hud.add(resolutionLabel);
+        hud.add(resolutionText, {hudValueX, 8.0f + 3 * hudLine}, hudScale);
+        hud.setScreenSize(framebufferSize.x, framebufferSize.y);
+        hud.draw();
         //-------------------------------
 
         window.swapBuffers();
         Window::pollEvents();
+
+        frameArena.reset();
+        frameAllocations = memory::getThreadAllocations() + scheduler.getWorkerAllocations() - frameStart;
+        if (strictAllocations && currentFrame > warmUpTime && frameAllocations.allocations > 0) {
+            std::fprintf(stderr, "Warning: %llu heap allocations (%llu bytes) in the frame at %.2f s!\n",
+                         static_cast<unsigned long long>(frameAllocations.allocations),
+                         static_cast<unsigned long long>(frameAllocations.bytes), currentFrame);
+        }
     }
+
+    std::cout << "Snapshots: " << snapshots.getSaveBytesPerMs() << " bytes/ms saved, "
+              << snapshots.getRestoreBytesPerMs() << " bytes/ms restored\n";
+    std::cout << "Resolution: " << 100.0f * resolution.getScale() << "% at "
+              << resolution.getGpuMs() << " ms of GPU time per frame\n";
+    std::cout << "Sparks: " << sparks.getUpdatedPerMs() << " particles updated/ms, "
+              << sparks.getEmittedPerMs() << " emitted/ms\n"
+              << "Bursts: " << bursts.getUpdatedPerMs() << " particles updated/ms, "
+              << bursts.getEmittedPerMs() << " emitted/ms\n";
     return EXIT_SUCCESS;
 }
\ No newline at end of file
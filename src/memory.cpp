@@ -0,0 +1,120 @@
+#include "memory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+    // thread_local PODs need no dynamic initialization, so they are safe to
+    // touch from operator new at any point of a thread's life
+    thread_local uint64_t threadAllocations = 0;
+    thread_local uint64_t threadBytes = 0;
+    thread_local bool inHook = false;
+    std::atomic<uint64_t> totalAllocations{0};
+    std::atomic<uint64_t> totalBytes{0};
+    std::atomic<ph::memory::AllocationHook> hook{nullptr};
+
+    void* allocate(size_t size) {
+        ++threadAllocations;
+        threadBytes += size;
+        totalAllocations.fetch_add(1, std::memory_order_relaxed);
+        totalBytes.fetch_add(size, std::memory_order_relaxed);
+
+        const auto h = hook.load(std::memory_order_acquire);
+        if (h && !inHook) {
+            inHook = true;
+            h(size);
+            inHook = false;
+        }
+        // malloc(0) may return null, but new must not
+        return std::malloc(size ? size : 1);
+    }
+    void* allocateOrThrow(const size_t size) {
+        void* p = allocate(size);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+}
+
+void* operator new(const size_t size) {
+    return allocateOrThrow(size);
+}
+void* operator new[](const size_t size) {
+    return allocateOrThrow(size);
+}
+void* operator new(const size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+void* operator new[](const size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+ph::memory::AllocationStats ph::memory::getThreadAllocations() {
+    return {threadAllocations, threadBytes};
+}
+ph::memory::AllocationStats ph::memory::getAllocations() {
+    return {totalAllocations.load(std::memory_order_relaxed), totalBytes.load(std::memory_order_relaxed)};
+}
+void ph::memory::setAllocationHook(const AllocationHook h) {
+    hook.store(h, std::memory_order_release);
+}
+
+// class ph::memory::Arena
+ph::memory::Arena::Arena(const size_t capacity) {
+    blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[capacity]), capacity});
+}
+void* ph::memory::Arena::allocate(const size_t size, const size_t alignment) {
+    auto* block = &blocks.back();
+    auto base = reinterpret_cast<uintptr_t>(block->data.get());
+    auto start = (base + offset + alignment - 1) & ~(alignment - 1);
+
+    if (start + size > base + block->size) {
+        // chain a block that fits this allocation and leaves room for more
+        const size_t blockSize = std::max(size + alignment, 2 * block->size);
+        blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[blockSize]), blockSize});
+        block = &blocks.back();
+        offset = 0;
+        base = reinterpret_cast<uintptr_t>(block->data.get());
+        start = (base + alignment - 1) & ~(alignment - 1);
+    }
+    const size_t end = start + size - base;
+    used += end - offset;
+    offset = end;
+    peak = std::max(peak, used);
+    return reinterpret_cast<void*>(start);
+}
+void ph::memory::Arena::reset() {
+    if (blocks.size() > 1) {
+        // replace the chain with one block that holds everything this frame needed
+        const size_t capacity = getCapacity();
+        blocks.clear();
+        blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[capacity]), capacity});
+    }
+    offset = 0;
+    used = 0;
+}
+size_t ph::memory::Arena::getUsed() const {
+    return used;
+}
+size_t ph::memory::Arena::getPeak() const {
+    return peak;
+}
+size_t ph::memory::Arena::getCapacity() const {
+    size_t capacity = 0;
+    for (const auto& block : blocks)
+        capacity += block.size;
+    return capacity;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ph {
+    namespace memory {
+        // Linear allocator for transient data, e.g. scratch buffers that only
+        // live for one frame. Allocating bumps a pointer and nothing is freed
+        // individually: reset() releases everything at once.
+        //
+        // If the arena runs out it chains another block from the heap; the
+        // next reset() merges them into one block big enough for the whole
+        // frame, so a steady-state frame never touches the heap.
+        class Arena {
+            struct Block {
+                std::unique_ptr<uint8_t[]> data;
+                size_t size;
+            };
+            std::vector<Block> blocks;
+            size_t offset{0};       // into the last block
+            size_t used{0};         // over all blocks
+            size_t peak{0};
+
+        public:
+            explicit Arena(size_t capacity);
+            Arena(const Arena&) = delete;
+            Arena& operator=(const Arena&) = delete;
+
+            void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+            // room for count objects; they are not constructed, so only use
+            // types that don't need their destructor run
+            template<typename T>
+            T* allocate(const size_t count) {
+                static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed");
+                return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+            }
+            void reset();
+
+            size_t getUsed() const;
+            size_t getPeak() const;
+            size_t getCapacity() const;
+        };
+
+        // Lets standard containers take their memory from an arena, e.g.
+        // std::vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>{arena}}.
+        // Deallocation is a no-op; the container must not outlive the next reset().
+        template<typename T>
+        struct ArenaAllocator {
+            using value_type = T;
+            Arena* arena;
+
+            explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+            template<typename U>
+            ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+            T* allocate(const size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+            void deallocate(T*, size_t) {}
+        };
+        template<typename T, typename U>
+        bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+        template<typename T, typename U>
+        bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+        // Fixed-size object pool for things that come and go at runtime, such
+        // as entities and level chunks. Objects are carved out of blocks of
+        // blockSize slots and freed slots are reused, so once the pool has
+        // grown to its working size creating and destroying is heap free.
+        template<typename T>
+        class Pool {
+            union Slot {
+                Slot* next;
+                typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+            };
+            const size_t blockSize;
+            std::vector<std::unique_ptr<Slot[]>> blocks;
+            Slot* freeList{nullptr};
+            size_t size{0};
+
+            void grow() {
+                blocks.emplace_back(new Slot[blockSize]);
+                Slot* block = blocks.back().get();
+                for (size_t i = 0; i < blockSize; ++i) {
+                    block[i].next = freeList;
+                    freeList = &block[i];
+                }
+            }
+
+        public:
+            explicit Pool(const size_t blockSize = 64) : blockSize(blockSize) {}
+            // every object must have been destroyed by now
+            ~Pool() { assert(size == 0 && "objects leaked from pool"); }
+            Pool(const Pool&) = delete;
+            Pool& operator=(const Pool&) = delete;
+
+            template<typename... Args>
+            T* create(Args&&... args) {
+                if (!freeList)
+                    grow();
+                // unlink first: the object overwrites the link
+                Slot* slot = freeList;
+                freeList = slot->next;
+                ++size;
+                return new (&slot->storage) T(std::forward<Args>(args)...);
+            }
+            void destroy(T* object) {
+                if (!object)
+                    return;
+                object->~T();
+                Slot* slot = reinterpret_cast<Slot*>(object);
+                slot->next = freeList;
+                freeList = slot;
+                --size;
+            }
+            // grows the pool so that count objects fit without allocating
+            void reserve(const size_t count) {
+                while (blocks.size() * blockSize < count)
+                    grow();
+            }
+
+            size_t getSize() const { return size; }
+            size_t getCapacity() const { return blocks.size() * blockSize; }
+        };
+
+        // ALLOCATION TRACKING
+        // Global operator new is replaced (see memory.cpp) to count every heap
+        // allocation, so a frame can check how much it allocated.
+        struct AllocationStats {
+            uint64_t allocations;
+            uint64_t bytes;
+        };
+        inline AllocationStats operator+(const AllocationStats& a, const AllocationStats& b) {
+            return {a.allocations + b.allocations, a.bytes + b.bytes};
+        }
+        inline AllocationStats operator-(const AllocationStats& a, const AllocationStats& b) {
+            return {a.allocations - b.allocations, a.bytes - b.bytes};
+        }
+
+        // heap allocations made by the calling thread since it started
+        AllocationStats getThreadAllocations();
+        // heap allocations made by every thread since the program started
+        AllocationStats getAllocations();
+
+        // called on the allocating thread for every heap allocation, e.g. to
+        // break on allocations in code that must not allocate. Allocations
+        // made by the hook itself are not reported. Pass nullptr to remove it.
+        using AllocationHook = void (*)(size_t size);
+        void setAllocationHook(AllocationHook hook);
+    }
+}
@@ -0,0 +1,258 @@
+#include "particles.h"
+
+#include <algorithm>
+#include <chrono>
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PH_PARTICLES_SSE
+#endif
+
+namespace {
+#ifdef PH_PARTICLES_SSE
+    constexpr bool HAS_SSE = true;
+#else
+    constexpr bool HAS_SSE = false;
+#endif
+    size_t roundUp4(const size_t n) {
+        return (n + 3) & ~size_t{3};
+    }
+    // instance attribute sections of the streaming buffer, in order
+    enum Section { X, Y, Z, SIZE, FADE, COLOR, NUM_SECTIONS };
+}
+
+// class ph::ParticleSimulation
+ph::ParticleSimulation::ParticleSimulation(const size_t capacity)
+    : capacity(roundUp4(capacity)),
+      positionX(this->capacity), positionY(this->capacity), positionZ(this->capacity),
+      fade(this->capacity), size(this->capacity), color(this->capacity),
+      velocityX(this->capacity), velocityY(this->capacity), velocityZ(this->capacity),
+      accelerationX(this->capacity), accelerationY(this->capacity), accelerationZ(this->capacity),
+      life(this->capacity), inverseLifetime(this->capacity), vectorized(HAS_SSE) {}
+float ph::ParticleSimulation::nextRandom() {
+    // xorshift32, mapped to [0, 1)
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return (random >> 8) * (1.0f / 16777216.0f);
+}
+size_t ph::ParticleSimulation::emit(const ParticleEmitter& emitter, size_t n) {
+    const auto begin = std::chrono::steady_clock::now();
+    n = std::min(n, capacity - count);
+
+    for (size_t i = count; i < count + n; ++i) {
+        // a random point in the unit ball, by rejection
+        glm::vec3 d;
+        do {
+            d = glm::vec3{nextRandom(), nextRandom(), nextRandom()} * 2.0f - 1.0f;
+        } while (glm::dot(d, d) > 1.0f);
+        const glm::vec3 v = emitter.velocity + emitter.spread * d;
+        const float lifetime = emitter.minLifetime + (emitter.maxLifetime - emitter.minLifetime) * nextRandom();
+
+        positionX[i] = emitter.position.x;
+        positionY[i] = emitter.position.y;
+        positionZ[i] = emitter.position.z;
+        velocityX[i] = v.x;
+        velocityY[i] = v.y;
+        velocityZ[i] = v.z;
+        accelerationX[i] = emitter.acceleration.x;
+        accelerationY[i] = emitter.acceleration.y;
+        accelerationZ[i] = emitter.acceleration.z;
+        life[i] = lifetime;
+        inverseLifetime[i] = 1.0f / std::max(lifetime, 1.0e-6f);
+        fade[i] = 1.0f;
+        size[i] = emitter.size;
+        color[i] = emitter.color;
+    }
+    count += n;
+
+    const auto elapsed = std::chrono::steady_clock::now() - begin;
+    particlesEmitted.fetch_add(n, std::memory_order_relaxed);
+    emitNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                              std::memory_order_relaxed);
+    return n;
+}
+void ph::ParticleSimulation::setDrag(const float drag) {
+    this->drag = drag;
+}
+void ph::ParticleSimulation::update(const float deltaTime) {
+    const auto begin = std::chrono::steady_clock::now();
+    const size_t updated = count;
+    integrate(deltaTime);
+    compact();
+
+    const auto elapsed = std::chrono::steady_clock::now() - begin;
+    particlesUpdated.fetch_add(updated, std::memory_order_relaxed);
+    updateNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                std::memory_order_relaxed);
+}
+void ph::ParticleSimulation::integrate(const float deltaTime) {
+    const float damping = std::max(0.0f, 1.0f - drag * deltaTime);
+    // the arrays are padded to a multiple of 4, so the last group may run
+    // into unused entries; whatever ends up there is never read back
+    const size_t end = roundUp4(count);
+#ifdef PH_PARTICLES_SSE
+    if (vectorized) {
+        integrateSSE(deltaTime, damping, end);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < end; ++i) {
+        velocityX[i] = (velocityX[i] + accelerationX[i] * deltaTime) * damping;
+        velocityY[i] = (velocityY[i] + accelerationY[i] * deltaTime) * damping;
+        velocityZ[i] = (velocityZ[i] + accelerationZ[i] * deltaTime) * damping;
+        positionX[i] += velocityX[i] * deltaTime;
+        positionY[i] += velocityY[i] * deltaTime;
+        positionZ[i] += velocityZ[i] * deltaTime;
+        life[i] -= deltaTime;
+        fade[i] = life[i] * inverseLifetime[i];
+    }
+}
+#ifdef PH_PARTICLES_SSE
+void ph::ParticleSimulation::integrateSSE(const float deltaTime, const float damping, const size_t end) {
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 d = _mm_set1_ps(damping);
+    const auto step = [&](float* p, float* v, const float* a, const size_t i) {
+        // v = (v + a dt) * damping; p += v dt
+        const __m128 vi = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(v + i), _mm_mul_ps(_mm_loadu_ps(a + i), dt)), d);
+        _mm_storeu_ps(v + i, vi);
+        _mm_storeu_ps(p + i, _mm_add_ps(_mm_loadu_ps(p + i), _mm_mul_ps(vi, dt)));
+    };
+    for (size_t i = 0; i < end; i += 4) {
+        step(positionX.data(), velocityX.data(), accelerationX.data(), i);
+        step(positionY.data(), velocityY.data(), accelerationY.data(), i);
+        step(positionZ.data(), velocityZ.data(), accelerationZ.data(), i);
+        const __m128 l = _mm_sub_ps(_mm_loadu_ps(&life[i]), dt);
+        _mm_storeu_ps(&life[i], l);
+        _mm_storeu_ps(&fade[i], _mm_mul_ps(l, _mm_loadu_ps(&inverseLifetime[i])));
+    }
+}
+#endif
+void ph::ParticleSimulation::compact() {
+    size_t i = 0;
+    while (i < count) {
+#ifdef PH_PARTICLES_SSE
+        // skip groups of four live particles without looking at each one
+        if (vectorized && i + 4 <= count && _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&life[i]), _mm_setzero_ps())) == 0) {
+            i += 4;
+            continue;
+        }
+#endif
+        if (life[i] > 0.0f) {
+            ++i;
+            continue;
+        }
+        // swap-remove: the last particle takes the dead one's place and is checked next
+        const size_t last = --count;
+        positionX[i] = positionX[last];
+        positionY[i] = positionY[last];
+        positionZ[i] = positionZ[last];
+        velocityX[i] = velocityX[last];
+        velocityY[i] = velocityY[last];
+        velocityZ[i] = velocityZ[last];
+        accelerationX[i] = accelerationX[last];
+        accelerationY[i] = accelerationY[last];
+        accelerationZ[i] = accelerationZ[last];
+        life[i] = life[last];
+        inverseLifetime[i] = inverseLifetime[last];
+        fade[i] = fade[last];
+        size[i] = size[last];
+        color[i] = color[last];
+    }
+}
+bool ph::ParticleSimulation::isVectorized() const {
+    return vectorized;
+}
+void ph::ParticleSimulation::setVectorized(const bool vectorized) {
+    this->vectorized = vectorized && HAS_SSE;
+}
+size_t ph::ParticleSimulation::getCount() const {
+    return count;
+}
+size_t ph::ParticleSimulation::getCapacity() const {
+    return capacity;
+}
+double ph::ParticleSimulation::getUpdatedPerMs() const {
+    const uint64_t ns = updateNanoseconds.load(std::memory_order_relaxed);
+    return ns ? particlesUpdated.load(std::memory_order_relaxed) * 1.0e6 / ns : 0.0;
+}
+double ph::ParticleSimulation::getEmittedPerMs() const {
+    const uint64_t ns = emitNanoseconds.load(std::memory_order_relaxed);
+    return ns ? particlesEmitted.load(std::memory_order_relaxed) * 1.0e6 / ns : 0.0;
+}
+
+// class ph::ParticleSystem
+ph::ParticleSystem::ParticleSystem(const Archive& archive, const std::string& textureName, const size_t capacity,
+                                   const glm::ivec2& frameGrid, const int numFrames)
+    : ParticleSimulation(capacity),
+      texture(archive, textureName), shader(archive, "shaders/particle.vert", "shaders/particle.frag"),
+      frameGrid(frameGrid), numFrames(std::max(numFrames, 1)) {
+    // a unit quad, instanced once per particle
+    constexpr float corners[] = {
+        -0.5f, -0.5f,   0.5f, -0.5f,   0.5f,  0.5f,
+         0.5f,  0.5f,  -0.5f,  0.5f,  -0.5f, -0.5f,
+    };
+    glGenVertexArrays(1, &id);
+    glGenBuffers(1, &quad_id);
+    glGenBuffers(1, &instance_id);
+    glBindVertexArray(id);
+
+    glBindBuffer(GL_ARRAY_BUFFER, quad_id);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glEnableVertexAttribArray(0);
+
+    // every array gets a section of capacity entries, so the attribute
+    // pointers never change and only the live part is uploaded each frame
+    glBindBuffer(GL_ARRAY_BUFFER, instance_id);
+    const size_t sectionSize = this->capacity * sizeof(float);
+    glBufferData(GL_ARRAY_BUFFER, NUM_SECTIONS * sectionSize, nullptr, GL_STREAM_DRAW);
+    for (GLuint s = X; s < NUM_SECTIONS; ++s) {
+        const auto offset = reinterpret_cast<void*>(s * sectionSize);
+        if (s == COLOR)
+            glVertexAttribPointer(1 + s, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, offset);
+        else
+            glVertexAttribPointer(1 + s, 1, GL_FLOAT, GL_FALSE, 0, offset);
+        glVertexAttribDivisor(1 + s, 1);
+        glEnableVertexAttribArray(1 + s);
+    }
+
+    gl::bind(shader);
+    gl::setUniform(shader, "uTexture", 0);
+}
+ph::ParticleSystem::~ParticleSystem() {
+    glDeleteVertexArrays(1, &id);
+    glDeleteBuffers(1, &quad_id);
+    glDeleteBuffers(1, &instance_id);
+}
+void ph::ParticleSystem::draw(const glm::mat4& view, const glm::mat4& projection) const {
+    if (count == 0)
+        return;
+
+    // orphan the buffer, then upload the live part of each array into its section
+    glBindBuffer(GL_ARRAY_BUFFER, instance_id);
+    const size_t sectionSize = capacity * sizeof(float);
+    glBufferData(GL_ARRAY_BUFFER, NUM_SECTIONS * sectionSize, nullptr, GL_STREAM_DRAW);
+    const void* sections[NUM_SECTIONS] = {
+        positionX.data(), positionY.data(), positionZ.data(), size.data(), fade.data(), color.data(),
+    };
+    for (size_t s = X; s < NUM_SECTIONS; ++s)
+        glBufferSubData(GL_ARRAY_BUFFER, s * sectionSize, count * sizeof(float), sections[s]);
+
+    gl::bind(texture);
+    gl::bind(shader);
+    const GLuint program = shader.getID();
+    glUniformMatrix4fv(glGetUniformLocation(program, "uView"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(glGetUniformLocation(program, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
+    glUniform2f(glGetUniformLocation(program, "uFrameGrid"), frameGrid.x, frameGrid.y);
+    glUniform1f(glGetUniformLocation(program, "uNumFrames"), static_cast<float>(numFrames));
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(id);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
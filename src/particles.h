@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "ph.h"
+
+namespace ph {
+    // What a burst or stream of particles starts out as.
+    struct ParticleEmitter {
+        glm::vec3 position{0.0f};
+        glm::vec3 velocity{0.0f};           // mean initial velocity
+        float spread{1.0f};                 // random speed added in a random direction, up to this much
+        glm::vec3 acceleration{0.0f};       // e.g. gravity, or buoyancy for embers
+        float minLifetime{0.5f};            // seconds
+        float maxLifetime{1.0f};
+        float size{0.1f};                   // world units
+        glm::u8vec4 color{255, 255, 255, 255};
+    };
+
+    // CPU simulation of up to hundreds of thousands of particles, without
+    // anything to draw them with, so it runs without a GL context.
+    //
+    // Particles are stored as a structure of arrays so update() can integrate
+    // four at a time with SSE (with a scalar fallback), and dead particles are
+    // removed by moving the last particle into their place, which keeps the
+    // live ones packed at the front. All memory is allocated up front:
+    // emitting past the capacity drops the extra particles.
+    class ParticleSimulation {
+    protected:
+        const size_t capacity;              // rounded up to a multiple of 4
+        size_t count{0};
+
+        // one entry per particle; what drawing needs
+        std::vector<float> positionX, positionY, positionZ;
+        std::vector<float> fade;            // fraction of life left, for the shader
+        std::vector<float> size;
+        std::vector<glm::u8vec4> color;
+
+    private:
+        // the rest of each particle
+        std::vector<float> velocityX, velocityY, velocityZ;
+        std::vector<float> accelerationX, accelerationY, accelerationZ;
+        std::vector<float> life;            // seconds left
+        std::vector<float> inverseLifetime;
+
+        float drag{0.0f};
+        uint32_t random{0x9e3779b9u};
+        bool vectorized;
+
+        std::atomic<uint64_t> particlesUpdated{0};
+        std::atomic<uint64_t> updateNanoseconds{0};
+        std::atomic<uint64_t> particlesEmitted{0};
+        std::atomic<uint64_t> emitNanoseconds{0};
+
+        float nextRandom();
+        void integrate(float deltaTime);
+        // the SSE half of integrate(), compiled where available
+        void integrateSSE(float deltaTime, float damping, size_t end);
+        void compact();
+
+    public:
+        explicit ParticleSimulation(size_t capacity);
+        ParticleSimulation(const ParticleSimulation&) = delete;
+        ParticleSimulation& operator=(const ParticleSimulation&) = delete;
+
+        // returns how many particles were emitted, which is fewer than asked when full
+        size_t emit(const ParticleEmitter& emitter, size_t count);
+        // velocity lost per second, as a fraction
+        void setDrag(float drag);
+        void update(float deltaTime);
+
+        // whether update() uses SSE; on by default where it was compiled in,
+        // and can be turned off to compare against the scalar code
+        bool isVectorized() const;
+        void setVectorized(bool vectorized);
+
+        size_t getCount() const;
+        size_t getCapacity() const;
+
+        // throughput of update() and emit(), in particles per millisecond
+        double getUpdatedPerMs() const;
+        double getEmittedPerMs() const;
+    };
+
+    // A particle simulation drawn as camera-facing quads with one instanced
+    // draw call. Each array is uploaded as is into its own section of a
+    // streaming instance buffer.
+    //
+    // The texture may be a grid of animation frames, which are played once
+    // over each particle's life.
+    class ParticleSystem : public ParticleSimulation {
+        const Texture texture;
+        const Shader shader;
+        glm::vec2 frameGrid;
+        int numFrames;
+        GLuint id{0};
+        GLuint quad_id{0};
+        GLuint instance_id{0};
+
+    public:
+        // frameGrid is the number of columns and rows of frames in the
+        // texture, of which the first numFrames are used, row by row from the top
+        ParticleSystem(const Archive& archive, const std::string& textureName, size_t capacity,
+                       const glm::ivec2& frameGrid = glm::ivec2{1, 1}, int numFrames = 1);
+        ~ParticleSystem();
+        ParticleSystem(const ParticleSystem&) = delete;
+        ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+        // draws with blending on and depth writes off; call after the opaque geometry
+        void draw(const glm::mat4& view, const glm::mat4& projection) const;
+    };
+}
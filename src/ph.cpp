@@ -1,5 +1,6 @@
 #include "ph.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <fstream>
@@ -26,7 +27,7 @@ ph::Window::Window(const int width, const int height) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
 
     window = glfwCreateWindow(width, height, "Dungeon remake!!", nullptr, nullptr);
 
@@ -45,7 +46,10 @@ ph::Window::Window(const int width, const int height) {
     glViewport(0, 0, width, height);
     glEnable(GL_DEPTH_TEST);
 
-    glfwSetWindowSizeCallback(window, [](GLFWwindow* _, const int w, const int h) {
+    // the framebuffer size callback gets the new size in pixels, which
+    // differs from screen coordinates on high DPI displays.
+    // Offscreen render targets follow getFramebufferSize() on their own.
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* _, const int w, const int h) {
         glViewport(0, 0, w, h);
     });
 }
@@ -288,6 +292,11 @@ bool ph::Window::isKeyPressed(const input::Key key) const {
 void ph::Window::pollEvents() {
     glfwPollEvents();
 }
+glm::ivec2 ph::Window::getFramebufferSize() const {
+    glm::ivec2 size;
+    glfwGetFramebufferSize(window, &size.x, &size.y);
+    return size;
+}
 void ph::Window::swapBuffers() const {
     glfwSwapBuffers(window);
 }
@@ -303,8 +312,23 @@ ph::Shader::Shader(const std::string& vertexShaderPath, const std::string& fragm
     file.open(fragmentShaderPath);
     fBuffer << file.rdbuf();
     file.close();
-    const std::string vs_str = vBuffer.str(), fs_str = fBuffer.str();
-    const char *vs_cstr = vs_str.c_str(), *fs_cstr = fs_str.c_str();
+    compile(vBuffer.str(), fBuffer.str());
+}
+ph::Shader::Shader(const Archive& archive, const std::string& vertexShaderName, const std::string& fragmentShaderName) {
+    // LOAD SHADER SOURCES
+    const auto vsEntry = archive.find(vertexShaderName);
+    const auto fsEntry = archive.find(fragmentShaderName);
+    if (!vsEntry || !fsEntry) {
+        std::cout << "Error: Failed to find shader " << (vsEntry ? fragmentShaderName : vertexShaderName)
+                  << " in archive!\n";
+        return;
+    }
+    const auto vsData = reinterpret_cast<const char*>(archive.getData(*vsEntry));
+    const auto fsData = reinterpret_cast<const char*>(archive.getData(*fsEntry));
+    compile(std::string(vsData, vsEntry->size), std::string(fsData, fsEntry->size));
+}
+void ph::Shader::compile(const std::string& vertexSource, const std::string& fragmentSource) {
+    const char *vs_cstr = vertexSource.c_str(), *fs_cstr = fragmentSource.c_str();
 
     // CREATE VERTEX SHADER
     const GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -391,6 +415,43 @@ ph::Texture::Texture(const std::string& imagePath) {
     );
     glGenerateMipmap(GL_TEXTURE_2D);
 }
+ph::Texture::Texture(const Archive& archive, const std::string& name) {
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    const auto entry = archive.find(name);
+    if (!entry || entry->type != archive::EntryType::Texture) {
+        std::cout << "Error: Failed to find texture " << name << " in archive!\n";
+        return;
+    }
+
+    // the pixels are already RGBA, flipped and mipmapped, so upload each level as is;
+    // the archive has checked that the levels fill the payload exactly
+    const stbi_uc* data = archive.getData(*entry);
+    GLsizei width = entry->width, height = entry->height;
+    for (GLint level = 0; level < static_cast<GLint>(entry->mipLevels); ++level) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        data += width * height * 4;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry->mipLevels - 1);
+}
+ph::Texture::Texture(const int width, const int height, const bool mipmapped) {
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    if (mipmapped)
+        glGenerateMipmap(GL_TEXTURE_2D);
+}
 ph::Texture::~Texture() {
     glDeleteTextures(1, &id);
 }
@@ -398,31 +459,98 @@ GLuint ph::Texture::getID() const {
     return id;
 }
 
+// class ph::Framebuffer
+ph::Framebuffer::Framebuffer(const int width, const int height, const bool depth, const bool mipmapped)
+    : texture(width, height, mipmapped), width(width), height(height) {
+    glGenFramebuffers(1, &id);
+    glBindFramebuffer(GL_FRAMEBUFFER, id);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.getID(), 0);
+    if (depth) {
+        glGenRenderbuffers(1, &depth_id);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth_id);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_id);
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Error: Framebuffer of " << width << "x" << height << " is incomplete!\n";
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+ph::Framebuffer::~Framebuffer() {
+    glDeleteFramebuffers(1, &id);
+    glDeleteRenderbuffers(1, &depth_id);
+}
+GLuint ph::Framebuffer::getID() const {
+    return id;
+}
+const ph::Texture& ph::Framebuffer::getTexture() const {
+    return texture;
+}
+int ph::Framebuffer::getWidth() const {
+    return width;
+}
+int ph::Framebuffer::getHeight() const {
+    return height;
+}
+
 
 // class ph::VertexArray
-ph::VertexArray::VertexArray(const float* vertices, const size_t count, const std::vector<int>& attributeSizes) : count(
-    count) {
+ph::VertexArray::VertexArray(const float* vertices, const size_t count, const std::vector<int>& attributeSizes) {
+    create(attributeSizes, vertices, count);
+}
+ph::VertexArray::VertexArray(const std::vector<int>& attributeSizes) {
+    create(attributeSizes, nullptr, 0);
+}
+void ph::VertexArray::create(const std::vector<int>& attributeSizes, const float* vertices, const size_t count) {
+    // every attribute is a float vector, packed one after the other
+    std::vector<AttributeFormat> attributes;
+    size_t offset = 0;
+    for (const auto s : attributeSizes) {
+        attributes.push_back({GL_FLOAT, s, false, false, offset});
+        offset += s * sizeof(float);
+    }
+    create(attributes.data(), attributes.size(), offset, vertices, count * sizeof(float));
+}
+void ph::VertexArray::create(const AttributeFormat* attributes, const size_t numAttributes, const GLsizei stride,
+                             const void* vertices, const size_t size) {
+    this->stride = stride;
     glGenVertexArrays(1, &id);
     glGenBuffers(1, &vbo_id);
 
     glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
-    glBufferData(GL_ARRAY_BUFFER, count * sizeof(float), vertices, GL_STATIC_DRAW);
+    if (vertices) {
+        glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+        capacity = size;
+        count = size / stride;
+    }
 
     glBindVertexArray(id);
-
-    int stride = 0;
-    for (const auto s : attributeSizes) {
-        stride += s * sizeof(float);
-    }
-    size_t offset = 0;
-    for (size_t i = 0; i < attributeSizes.size(); i++) {
-        // parameters: which attribute, size of vertex attribute, data type, normalize?, stride, offset (void*).
-        glVertexAttribPointer(i, attributeSizes[i], GL_FLOAT, GL_FALSE, stride,
-                              reinterpret_cast<void*>(offset));
+    for (size_t i = 0; i < numAttributes; i++) {
+        const auto& a = attributes[i];
+        const auto offset = reinterpret_cast<void*>(a.offset);
+        // parameters: which attribute, size of vertex attribute, data type, (normalize?), stride, offset (void*).
+        if (a.integer)
+            glVertexAttribIPointer(i, a.size, a.type, stride, offset);
+        else
+            glVertexAttribPointer(i, a.size, a.type, a.normalized ? GL_TRUE : GL_FALSE, stride, offset);
         glEnableVertexAttribArray(i);
-        offset += attributeSizes[i] * sizeof(float);
     }
 }
+void ph::VertexArray::update(const float* vertices, const size_t count) {
+    upload(vertices, count * sizeof(float));
+}
+void ph::VertexArray::upload(const void* vertices, const size_t size) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
+    if (size > capacity) {
+        // grow the buffer
+        glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STREAM_DRAW);
+        capacity = size;
+    } else {
+        // orphan the old storage so we don't wait on draws still reading it
+        glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices);
+    }
+    count = size / stride;
+}
 ph::VertexArray::~VertexArray() {
     glDeleteVertexArrays(1, &id);
     glDeleteBuffers(1, &vbo_id);
@@ -448,6 +576,14 @@ void ph::gl::bind(const Shader& shader) {
 void ph::gl::bind(const VertexArray& vertexArray) {
     glBindVertexArray(vertexArray.getID());
 }
+void ph::gl::bind(const Framebuffer& framebuffer) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.getID());
+    glViewport(0, 0, framebuffer.getWidth(), framebuffer.getHeight());
+}
+void ph::gl::bindDefaultFramebuffer(const int width, const int height) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
 void ph::gl::setUniform(const Shader& shader, const std::string& name, const int value) {
     glUniform1i(glGetUniformLocation(shader.getID(), name.c_str()), value);
 }
@@ -461,6 +597,11 @@ void ph::gl::setUniform(const Shader& shader, const std::string& name, const glm
 void ph::gl::draw(const VertexArray& vertexArray) {
     glDrawArrays(GL_TRIANGLES, 0, vertexArray.getCount());
 }
+void ph::gl::draw(const VertexArray& vertexArray, const size_t first, const size_t count) {
+    // clamped so a stale range can't read past the end of the buffer
+    const size_t available = first < vertexArray.getCount() ? vertexArray.getCount() - first : 0;
+    glDrawArrays(GL_TRIANGLES, first, std::min(count, available));
+}
 
 // class ph::Camera
 ph::Camera::Camera(const glm::vec3& position, const glm::vec3& target) : position(position), target(target) {}
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "archive.h"
 
 namespace ph {
     namespace input {
@@ -39,6 +46,8 @@ namespace ph {
         bool isOpen() const;
         void setShouldClose(bool val) const;
         bool isKeyPressed(input::Key key) const;
+        // size of the window's framebuffer in pixels
+        glm::ivec2 getFramebufferSize() const;
         static void pollEvents();
         void swapBuffers() const;
     };
@@ -48,34 +57,188 @@ namespace ph {
 
     public:
         explicit Texture(const std::string& imagePath);
+        // uploads a texture baked by the pack tool, including its mip chain
+        Texture(const Archive& archive, const std::string& name);
+        // an empty RGBA texture to render into, with linear filtering
+        Texture(int width, int height, bool mipmapped = false);
         ~Texture();
 
         GLuint getID() const;
     };
+    // An offscreen render target: a color texture and, optionally, a depth
+    // buffer. Binding it also sets the viewport to cover all of it.
+    class Framebuffer {
+        GLuint id{0};
+        GLuint depth_id{0};
+        Texture texture;
+        int width;
+        int height;
+
+    public:
+        Framebuffer(int width, int height, bool depth = true, bool mipmapped = false);
+        ~Framebuffer();
+        Framebuffer(const Framebuffer&) = delete;
+        Framebuffer& operator=(const Framebuffer&) = delete;
+
+        GLuint getID() const;
+        const Texture& getTexture() const;
+        int getWidth() const;
+        int getHeight() const;
+    };
     class Shader {
         const GLuint id = glCreateProgram();
 
+        void compile(const std::string& vertexSource, const std::string& fragmentSource);
+
     public:
         Shader(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
+        Shader(const Archive& archive, const std::string& vertexShaderName, const std::string& fragmentShaderName);
         ~Shader();
 
         GLuint getID() const;
     };
+    // Half precision floats, stored as raw bits. Texture coordinates on the
+    // tilemap grid (multiples of 1/256) are represented exactly.
+    struct Half2 {
+        uint16_t x, y;
+
+        Half2() = default;
+        explicit Half2(const glm::vec2& v) : x(glm::packHalf1x16(v.x)), y(glm::packHalf1x16(v.y)) {}
+    };
+    struct Half4 {
+        uint16_t x, y, z, w;
+
+        Half4() = default;
+        explicit Half4(const glm::vec4& v) : x(glm::packHalf1x16(v.x)), y(glm::packHalf1x16(v.y)),
+                                             z(glm::packHalf1x16(v.z)), w(glm::packHalf1x16(v.w)) {}
+    };
+    // An integer vector the shader reads as floats normalized to [0, 1]
+    // (unsigned) or [-1, 1] (signed), e.g. Normalized<glm::i8vec4> for normals.
+    template<typename T>
+    struct Normalized : T {
+        Normalized() = default;
+        Normalized(const T& v) : T(v) {}
+    };
+
+    // How OpenGL reads one attribute type. Only the specialized types below
+    // can be used in a vertex layout.
+    template<typename T>
+    struct AttributeTraits;
+
+    template<GLenum Type, GLint Size, bool Normalize, bool Integer>
+    struct AttributeFormatOf {
+        static constexpr GLenum type = Type;
+        static constexpr GLint size = Size;
+        static constexpr bool normalized = Normalize;
+        static constexpr bool integer = Integer;    // read as ints by the shader (glVertexAttribIPointer)
+    };
+    template<> struct AttributeTraits<float>        : AttributeFormatOf<GL_FLOAT, 1, false, false> {};
+    template<> struct AttributeTraits<glm::vec2>    : AttributeFormatOf<GL_FLOAT, 2, false, false> {};
+    template<> struct AttributeTraits<glm::vec3>    : AttributeFormatOf<GL_FLOAT, 3, false, false> {};
+    template<> struct AttributeTraits<glm::vec4>    : AttributeFormatOf<GL_FLOAT, 4, false, false> {};
+    template<> struct AttributeTraits<Half2>        : AttributeFormatOf<GL_HALF_FLOAT, 2, false, false> {};
+    template<> struct AttributeTraits<Half4>        : AttributeFormatOf<GL_HALF_FLOAT, 4, false, false> {};
+    template<> struct AttributeTraits<int32_t>      : AttributeFormatOf<GL_INT, 1, false, true> {};
+    template<> struct AttributeTraits<glm::ivec2>   : AttributeFormatOf<GL_INT, 2, false, true> {};
+    template<> struct AttributeTraits<glm::ivec3>   : AttributeFormatOf<GL_INT, 3, false, true> {};
+    template<> struct AttributeTraits<glm::ivec4>   : AttributeFormatOf<GL_INT, 4, false, true> {};
+    template<> struct AttributeTraits<glm::u8vec4>  : AttributeFormatOf<GL_UNSIGNED_BYTE, 4, false, true> {};
+    template<> struct AttributeTraits<glm::i8vec4>  : AttributeFormatOf<GL_BYTE, 4, false, true> {};
+    template<> struct AttributeTraits<glm::u16vec2> : AttributeFormatOf<GL_UNSIGNED_SHORT, 2, false, true> {};
+    template<> struct AttributeTraits<glm::i16vec2> : AttributeFormatOf<GL_SHORT, 2, false, true> {};
+    template<typename T>
+    struct AttributeTraits<Normalized<T>>
+        : AttributeFormatOf<AttributeTraits<T>::type, AttributeTraits<T>::size, true, false> {};
+
+    constexpr size_t componentSize(const GLenum type) {
+        return type == GL_BYTE || type == GL_UNSIGNED_BYTE ? 1 :
+               type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT ? 2 : 4;
+    }
+
+    // Runtime description of one attribute, as passed to glVertexAttribPointer.
+    struct AttributeFormat {
+        GLenum type;
+        GLint size;
+        bool normalized;
+        bool integer;
+        size_t offset;
+    };
+
+    // One member of a vertex struct; use PH_ATTRIBUTE to declare it.
+    template<typename T, size_t Offset>
+    struct Attribute {
+        static_assert(sizeof(T) == AttributeTraits<T>::size * componentSize(AttributeTraits<T>::type),
+                      "attribute size does not match its format");
+        static constexpr AttributeFormat format{AttributeTraits<T>::type, AttributeTraits<T>::size,
+                                                AttributeTraits<T>::normalized, AttributeTraits<T>::integer,
+                                                Offset};
+    };
+    template<typename T, size_t Offset>
+    constexpr AttributeFormat Attribute<T, Offset>::format;
+#define PH_ATTRIBUTE(Vertex, member) ::ph::Attribute<decltype(Vertex::member), offsetof(Vertex, member)>
+
+    // The layout of a vertex struct, worked out at compile time from its
+    // members. Attribute i is bound to shader location i, e.g.
+    //
+    //  struct TileVertex { glm::vec3 position; Normalized<glm::i8vec4> normal; Half2 texCoord; };
+    //  using TileLayout = ph::VertexLayout<TileVertex, PH_ATTRIBUTE(TileVertex, position),
+    //                                                  PH_ATTRIBUTE(TileVertex, normal),
+    //                                                  PH_ATTRIBUTE(TileVertex, texCoord)>;
+    template<typename V, typename... Attributes>
+    struct VertexLayout {
+        using Vertex = V;
+
+        static constexpr GLsizei stride = sizeof(Vertex);
+        static constexpr size_t numAttributes = sizeof...(Attributes);
+        static constexpr AttributeFormat attributes[] = {Attributes::format...};
+
+        static_assert(std::is_standard_layout<Vertex>::value, "offsetof needs a standard layout vertex");
+    };
+    template<typename V, typename... Attributes>
+    constexpr AttributeFormat VertexLayout<V, Attributes...>::attributes[];
+
     // Vertex array objects remember the precise binding and unbinding order
     // of the vertex buffer and element buffer objects. It then suffices to
     // bind the vertex array object when making render calls, instead of binding
     // each buffer and specifying the attribute pointers.
     //
-    // For now, we only store floats in our vertex data.
+    // Vertices are either structs described by a VertexLayout, or plain floats
+    // with a list of attribute sizes; in the latter case the count passed in
+    // is the number of floats. getCount() always returns the number of vertices.
+    //
+    // A vertex array created without vertices is a streaming buffer whose
+    // contents are replaced with update(), e.g. once per frame.
     class VertexArray {
         GLuint id{0};
         GLuint vbo_id{0};
         size_t count{0};
+        size_t capacity{0};     // in bytes
+        GLsizei stride{0};
+
+        void create(const AttributeFormat* attributes, size_t numAttributes, GLsizei stride,
+                    const void* vertices, size_t size);
+        void create(const std::vector<int>& attributeSizes, const float* vertices, size_t count);
+        void upload(const void* vertices, size_t size);
 
     public:
+        template<typename Layout>
+        VertexArray(Layout, const typename Layout::Vertex* vertices, size_t count) {
+            create(Layout::attributes, Layout::numAttributes, Layout::stride, vertices, count * Layout::stride);
+        }
+        template<typename Layout>
+        explicit VertexArray(Layout) {
+            create(Layout::attributes, Layout::numAttributes, Layout::stride, nullptr, 0);
+        }
         VertexArray(const float* vertices, size_t count, const std::vector<int>& attributeSizes);
+        explicit VertexArray(const std::vector<int>& attributeSizes);
         ~VertexArray();
 
+        template<typename Vertex>
+        void update(const Vertex* vertices, size_t count) {
+            upload(vertices, count * sizeof(Vertex));
+        }
+        void update(const float* vertices, size_t count);
+
         GLuint getID() const;
         size_t getCount() const;
     };
@@ -85,12 +248,17 @@ namespace ph {
         void bind(const Texture& texture);
         void bind(const Shader& shader);
         void bind(const VertexArray& vertexArray);
+        void bind(const Framebuffer& framebuffer);
+        // binds the window's framebuffer and sets the viewport to width x height
+        void bindDefaultFramebuffer(int width, int height);
 
         void setUniform(const Shader& shader, const std::string& name, int value);
         void setUniform(const Shader& shader, const std::string& name, const glm::mat4& value);
         void setUniform(const Shader& shader, const std::string& name, const glm::vec3& value);
 
         void draw(const VertexArray& vertexArray);
+        // draws count vertices starting at vertex first
+        void draw(const VertexArray& vertexArray, size_t first, size_t count);
     }
 
     class Camera {
@@ -0,0 +1,126 @@
+#include "resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // one triangle that covers the screen; the corners past it are clipped
+    constexpr float triangleVertices[] = {
+        -1.0f, -1.0f,
+         3.0f, -1.0f,
+        -1.0f,  3.0f,
+    };
+}
+
+// class ph::GpuTimer
+ph::GpuTimer::GpuTimer() {
+    glGenQueries(NUM_QUERIES, ids);
+}
+ph::GpuTimer::~GpuTimer() {
+    glDeleteQueries(NUM_QUERIES, ids);
+}
+void ph::GpuTimer::begin() {
+    // if every query is still in flight, drop the oldest rather than wait for it
+    collect();
+    glBeginQuery(GL_TIME_ELAPSED, ids[next]);
+}
+void ph::GpuTimer::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[next] = true;
+    next = (next + 1) % NUM_QUERIES;
+}
+void ph::GpuTimer::collect() {
+    // oldest first, so the newest available result wins
+    for (int i = 0; i < NUM_QUERIES; ++i) {
+        const int q = (next + i) % NUM_QUERIES;
+        if (!pending[q])
+            continue;
+        GLint available = 0;
+        glGetQueryObjectiv(ids[q], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(ids[q], GL_QUERY_RESULT, &ns);
+        pending[q] = false;
+        lastMs = ns * 1.0e-6;
+        fresh = true;
+    }
+}
+bool ph::GpuTimer::poll() {
+    collect();
+    const bool result = fresh;
+    fresh = false;
+    return result;
+}
+double ph::GpuTimer::getMs() const {
+    return lastMs;
+}
+
+// class ph::DynamicResolution
+ph::DynamicResolution::DynamicResolution(const Archive& archive, const glm::ivec2& windowSize, const float targetMs,
+                                         const float minScale)
+    : targetMs(targetMs), minScale(std::min(std::max(minScale, 0.1f), 1.0f)),
+      windowSize(windowSize), renderSize(windowSize),
+      target(new Framebuffer(windowSize.x, windowSize.y)),
+      upscaleShader(archive, "shaders/upscale.vert", "shaders/upscale.frag"),
+      triangle(triangleVertices, sizeof(triangleVertices)/sizeof(float), {2}) {
+    gl::bind(upscaleShader);
+    gl::setUniform(upscaleShader, "uTexture", 0);
+}
+void ph::DynamicResolution::adapt(const double gpuMs) {
+    if (gpuMs <= 0.0)
+        return;
+    // leave the scale alone while close enough, so it doesn't flicker
+    const double ratio = targetMs / gpuMs;
+    if (ratio > 0.95 && ratio < 1.2)
+        return;
+
+    // GPU time goes roughly with the number of pixels, i.e. with the scale squared.
+    // Timings lag a few frames behind, so only move part of the way: quickly
+    // when over budget, slowly when there is time to spare.
+    const float wanted = scale * static_cast<float>(std::sqrt(ratio));
+    scale += (wanted < scale ? 0.5f : 0.1f) * (wanted - scale);
+    scale = std::max(minScale, std::min(1.0f, scale));
+}
+void ph::DynamicResolution::begin(const glm::ivec2& size) {
+    if (timer.poll())
+        adapt(timer.getMs());
+
+    if (size != windowSize && size.x > 0 && size.y > 0) {
+        windowSize = size;
+        target.reset(new Framebuffer(size.x, size.y));
+    }
+    renderSize = glm::max(glm::ivec2{1, 1}, glm::ivec2{glm::vec2{windowSize} * scale + 0.5f});
+
+    gl::bind(*target);
+    glViewport(0, 0, renderSize.x, renderSize.y);
+    timer.begin();
+}
+void ph::DynamicResolution::end() {
+    timer.end();
+
+    gl::bindDefaultFramebuffer(windowSize.x, windowSize.y);
+    glDisable(GL_DEPTH_TEST);
+    gl::bind(upscaleShader);
+    gl::bind(target->getTexture());
+    const GLuint program = upscaleShader.getID();
+    // the part of the target the scene was drawn into, in texCoords, and
+    // how far in to stay so bilinear filtering doesn't reach past its edge
+    const glm::vec2 size{target->getWidth(), target->getHeight()};
+    const glm::vec2 extent = glm::vec2{renderSize} / size;
+    const glm::vec2 texel = 0.5f / size;
+    glUniform2f(glGetUniformLocation(program, "uExtent"), extent.x, extent.y);
+    glUniform2f(glGetUniformLocation(program, "uHalfTexel"), texel.x, texel.y);
+    gl::bind(triangle);
+    gl::draw(triangle);
+    glEnable(GL_DEPTH_TEST);
+}
+float ph::DynamicResolution::getScale() const {
+    return scale;
+}
+glm::ivec2 ph::DynamicResolution::getRenderSize() const {
+    return renderSize;
+}
+double ph::DynamicResolution::getGpuMs() const {
+    return timer.getMs();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "ph.h"
+
+namespace ph {
+    // Measures how long the GPU takes to run the commands between begin()
+    // and end(). Results arrive a few frames late; a small ring of queries
+    // lets them be collected without waiting for the GPU.
+    class GpuTimer {
+        static constexpr int NUM_QUERIES = 4;
+        GLuint ids[NUM_QUERIES]{};
+        bool pending[NUM_QUERIES]{};
+        int next{0};
+        double lastMs{0.0};
+        bool fresh{false};
+
+        void collect();
+
+    public:
+        GpuTimer();
+        ~GpuTimer();
+        GpuTimer(const GpuTimer&) = delete;
+        GpuTimer& operator=(const GpuTimer&) = delete;
+
+        void begin();
+        void end();
+
+        // true once per new measurement, which getMs() then returns
+        bool poll();
+        double getMs() const;
+    };
+
+    // Renders the scene offscreen at a fraction of the window's resolution
+    // and upscales it, adapting the fraction so the GPU time of the scene
+    // stays at the target frame time.
+    //
+    // The target is allocated at the full window size and the scene is drawn
+    // into its lower left corner, so changing the scale never reallocates.
+    // Scale is per axis: 0.5 draws a quarter of the pixels.
+    class DynamicResolution {
+        const float targetMs;
+        const float minScale;
+        float scale{1.0f};
+        glm::ivec2 windowSize;
+        glm::ivec2 renderSize;
+        std::unique_ptr<Framebuffer> target;
+        GpuTimer timer;
+        const Shader upscaleShader;
+        const VertexArray triangle;
+
+        void adapt(double gpuMs);
+
+    public:
+        DynamicResolution(const Archive& archive, const glm::ivec2& windowSize, float targetMs,
+                          float minScale = 0.5f);
+
+        // binds the offscreen target for the scene, after adapting the scale
+        // to the latest GPU timing and following any change of window size
+        void begin(const glm::ivec2& windowSize);
+        // upscales the scene to the window's framebuffer, which stays bound
+        // for anything drawn at full resolution afterwards, like the HUD
+        void end();
+
+        float getScale() const;
+        glm::ivec2 getRenderSize() const;
+        // GPU time of the scene in the latest measurement
+        double getGpuMs() const;
+    };
+}
@@ -0,0 +1,324 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+    template<typename T>
+    void append(std::vector<uint8_t>& out, const T& value) {
+        const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    // copies the tiles of one chunk into out (row by row), XORed with base if given
+    void gatherChunk(const Level& level, const Level* base, const int chunk, std::vector<uint8_t>& out) {
+        const auto bounds = level.getChunkBounds(chunk);
+        out.clear();
+        for (int y = bounds.y0; y < bounds.y1; ++y) {
+            for (int x = bounds.x0; x < bounds.x1; ++x) {
+                const auto t = static_cast<uint8_t>(level.at(x, y));
+                out.push_back(base ? t ^ static_cast<uint8_t>(base->at(x, y)) : t);
+            }
+        }
+    }
+
+    // run-length encodes the zero runs of a chunk as (zeros, count, literals...) groups
+    void encodeRuns(const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+        size_t i = 0;
+        while (i < in.size()) {
+            uint8_t zeros = 0;
+            while (i < in.size() && in[i] == 0 && zeros < 255) {
+                ++zeros;
+                ++i;
+            }
+            const size_t literals = i;
+            while (i < in.size() && in[i] != 0 && i - literals < 255)
+                ++i;
+            out.push_back(zeros);
+            out.push_back(static_cast<uint8_t>(i - literals));
+            out.insert(out.end(), in.begin() + literals, in.begin() + i);
+        }
+    }
+}
+
+void snapshot::encode(const Level& level, const Player& player, const Level* base, const uint32_t sequence,
+                      std::vector<uint8_t>& out) {
+    if (base && (base->width != level.width || base->height != level.height))
+        base = nullptr;
+
+    const size_t headerOffset = out.size();
+    Header header{};
+    std::memcpy(header.magic, MAGIC, 4);
+    header.version = VERSION;
+    header.sequence = sequence;
+    header.flags = base ? 0 : FLAG_KEYFRAME;
+    header.width = level.width;
+    header.height = level.height;
+    header.chunkSize = CHUNK_SIZE;
+    append(out, header);
+
+    PlayerRecord p{};
+    for (int i = 0; i < 3; ++i) {
+        p.acceleration[i] = player.acceleration[i];
+        p.velocity[i] = player.velocity[i];
+        p.position[i] = player.position[i];
+    }
+    append(out, p);
+
+    // chunks that are all zero after the XOR (unchanged, or all DIRT in a keyframe) are left out
+    std::vector<uint8_t> tiles;
+    tiles.reserve(CHUNK_SIZE * CHUNK_SIZE);
+    uint32_t chunkCount = 0;
+    for (int chunk = 0; chunk < level.getNumChunks(); ++chunk) {
+        gatherChunk(level, base, chunk, tiles);
+        if (std::all_of(tiles.begin(), tiles.end(), [](const uint8_t t) { return t == 0; }))
+            continue;
+
+        const size_t recordOffset = out.size();
+        append(out, ChunkRecord{static_cast<uint32_t>(chunk), 0});
+        encodeRuns(tiles, out);
+        const auto size = static_cast<uint32_t>(out.size() - recordOffset - sizeof(ChunkRecord));
+        std::memcpy(&out[recordOffset + offsetof(ChunkRecord, size)], &size, sizeof(size));
+        ++chunkCount;
+    }
+    std::memcpy(&out[headerOffset + offsetof(Header, chunkCount)], &chunkCount, sizeof(chunkCount));
+}
+bool snapshot::decode(const uint8_t* data, const size_t size, Level& level, Player& player) {
+    // READ HEADER
+    Header header;
+    if (size < sizeof(Header) + sizeof(PlayerRecord))
+        return false;
+    std::memcpy(&header, data, sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, 4) != 0 || header.version != VERSION ||
+        header.chunkSize != CHUNK_SIZE || header.width < 0 || header.height < 0) {
+        std::cerr << "Error: Unsupported snapshot format!\n";
+        return false;
+    }
+    const bool keyframe = header.flags & FLAG_KEYFRAME;
+    if (keyframe) {
+        level = Level{header.width, header.height};
+    } else if (level.width != header.width || level.height != header.height) {
+        std::cerr << "Error: Delta snapshot does not match the level it is applied to!\n";
+        return false;
+    }
+
+    // READ PLAYER
+    PlayerRecord p;
+    std::memcpy(&p, data + sizeof(Header), sizeof(PlayerRecord));
+    for (int i = 0; i < 3; ++i) {
+        player.acceleration[i] = p.acceleration[i];
+        player.velocity[i] = p.velocity[i];
+        player.position[i] = p.position[i];
+    }
+
+    // READ CHUNKS
+    size_t offset = sizeof(Header) + sizeof(PlayerRecord);
+    for (uint32_t c = 0; c < header.chunkCount; ++c) {
+        ChunkRecord record;
+        if (size - offset < sizeof(ChunkRecord))
+            return false;
+        std::memcpy(&record, data + offset, sizeof(ChunkRecord));
+        offset += sizeof(ChunkRecord);
+        if (record.index >= static_cast<uint32_t>(level.getNumChunks()) || size - offset < record.size)
+            return false;
+
+        const auto bounds = level.getChunkBounds(record.index);
+        const int w = bounds.x1 - bounds.x0;
+        const int n = w * (bounds.y1 - bounds.y0);
+
+        // expand the runs, XORing the literals onto the tiles
+        const uint8_t* in = data + offset;
+        const uint8_t* end = in + record.size;
+        int i = 0;
+        while (in + 2 <= end) {
+            i += in[0];
+            const int literals = in[1];
+            in += 2;
+            if (i + literals > n || end - in < literals)
+                return false;
+            for (int l = 0; l < literals; ++l, ++i) {
+                auto& t = level.at(bounds.x0 + i % w, bounds.y0 + i / w);
+                t = static_cast<Tile>(static_cast<uint8_t>(t) ^ in[l]);
+            }
+            in += literals;
+        }
+        offset += record.size;
+    }
+    return true;
+}
+bool snapshot::load(const std::string& path, Level& level, Player& player) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Failed to open snapshot at " << path << "!\n";
+        return false;
+    }
+    const std::vector<uint8_t> data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if (!decode(data.data(), data.size(), level, player)) {
+        std::cerr << "Error: Failed to load snapshot at " << path << "!\n";
+        return false;
+    }
+    return true;
+}
+
+// class SnapshotRecorder
+SnapshotRecorder::SnapshotRecorder(const size_t maxHistory, const uint32_t keyframeInterval)
+    : maxHistory(maxHistory), keyframeInterval(keyframeInterval) {
+    thread = std::thread(&SnapshotRecorder::run, this);
+}
+SnapshotRecorder::~SnapshotRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+}
+void SnapshotRecorder::capture(const Level& level, const Player& player) {
+    queue(level, player, "");
+}
+void SnapshotRecorder::save(const Level& level, const Player& player, const std::string& path) {
+    queue(level, player, path);
+}
+void SnapshotRecorder::queue(const Level& level, const Player& player, const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // reuse a spare capture so its tile buffer doesn't have to be reallocated
+        if (spare.empty()) {
+            pending.emplace_back();
+        } else {
+            pending.push_back(std::move(spare.back()));
+            spare.pop_back();
+        }
+        auto& capture = pending.back();
+        capture.level.width = level.width;
+        capture.level.height = level.height;
+        capture.level.tiles.assign(level.tiles.begin(), level.tiles.end());
+        capture.player = player;
+        capture.path = path;
+    }
+    wake.notify_one();
+}
+void SnapshotRecorder::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending.empty() && !busy; });
+}
+void SnapshotRecorder::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return !running || !pending.empty(); });
+        if (pending.empty())
+            break;      // stopping, and everything queued is done
+
+        working.swap(pending);
+        busy = true;
+        lock.unlock();
+        for (auto& capture : working)
+            record(capture);
+        lock.lock();
+        busy = false;
+        for (auto& capture : working)
+            spare.push_back(std::move(capture));
+        working.clear();
+        if (pending.empty())
+            idle.notify_all();
+    }
+}
+void SnapshotRecorder::record(Capture& capture) {
+    const auto begin = std::chrono::steady_clock::now();
+    scratch.clear();
+
+    if (!capture.path.empty()) {
+        // saves are always keyframes so the file stands on its own
+        snapshot::encode(capture.level, capture.player, nullptr, sequence, scratch);
+        std::ofstream file(capture.path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(scratch.data()), scratch.size());
+        if (!file)
+            std::cerr << "Error: Failed to write snapshot to " << capture.path << "!\n";
+    } else {
+        bool keyframe;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            keyframe = forceKeyframe || sequence % keyframeInterval == 0;
+            forceKeyframe = false;
+        }
+        snapshot::encode(capture.level, capture.player, keyframe ? nullptr : &previous, sequence, scratch);
+        ++sequence;
+        std::swap(previous, capture.level);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        history.push_back(scratch);
+        if (history.size() > maxHistory) {
+            // drop the oldest keyframe together with the deltas that depend on it
+            history.pop_front();
+            while (!history.empty()) {
+                snapshot::Header header;
+                std::memcpy(&header, history.front().data(), sizeof(header));
+                if (header.flags & snapshot::FLAG_KEYFRAME)
+                    break;
+                history.pop_front();
+            }
+        }
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - begin;
+    bytesEncoded.fetch_add(scratch.size(), std::memory_order_relaxed);
+    encodeNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                std::memory_order_relaxed);
+}
+size_t SnapshotRecorder::getHistorySize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return history.size();
+}
+bool SnapshotRecorder::restore(const size_t index, Level& level, Player& player) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index >= history.size())
+        return false;
+    const auto begin = std::chrono::steady_clock::now();
+
+    // find the keyframe this snapshot depends on and decode forward from it
+    size_t first = index;
+    while (first > 0) {
+        snapshot::Header header;
+        std::memcpy(&header, history[first].data(), sizeof(header));
+        if (header.flags & snapshot::FLAG_KEYFRAME)
+            break;
+        --first;
+    }
+    uint64_t bytes = 0;
+    for (size_t i = first; i <= index; ++i) {
+        if (!snapshot::decode(history[i].data(), history[i].size(), level, player))
+            return false;
+        bytes += history[i].size();
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - begin;
+    bytesDecoded.fetch_add(bytes, std::memory_order_relaxed);
+    decodeNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                std::memory_order_relaxed);
+    return true;
+}
+bool SnapshotRecorder::rewind(const size_t index, Level& level, Player& player) {
+    // captures still in flight belong after the point we rewind to
+    flush();
+    if (!restore(index, level, player))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    history.resize(index + 1);
+    // the background thread's delta base is now stale, so start over with a keyframe
+    forceKeyframe = true;
+    return true;
+}
+double SnapshotRecorder::getSaveBytesPerMs() const {
+    const uint64_t ns = encodeNanoseconds.load(std::memory_order_relaxed);
+    return ns ? bytesEncoded.load(std::memory_order_relaxed) * 1.0e6 / ns : 0.0;
+}
+double SnapshotRecorder::getRestoreBytesPerMs() const {
+    const uint64_t ns = decodeNanoseconds.load(std::memory_order_relaxed);
+    return ns ? bytesDecoded.load(std::memory_order_relaxed) * 1.0e6 / ns : 0.0;
+}
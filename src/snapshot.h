@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "level.h"
+
+// Binary game-state snapshots for quick-saves, rewind and replay.
+//
+// A snapshot is a Header, a PlayerRecord and one ChunkRecord (followed by
+// its payload) per stored chunk of the tile map. A chunk's tiles are XORed
+// against the same chunk of a base state and the result is run-length
+// encoded as (zero run, literal count, literals...) byte groups.
+//
+// Keyframes use an all-DIRT map as their base and stand on their own.
+// Delta snapshots use the previous snapshot as their base and leave out
+// every chunk that did not change, so restoring one means decoding forward
+// from the last keyframe. All integers are little endian.
+namespace snapshot {
+    constexpr char MAGIC[4] = {'P', 'H', 'S', 'S'};
+    constexpr uint32_t VERSION = 1;
+    constexpr uint32_t FLAG_KEYFRAME = 1;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t sequence;
+        uint32_t flags;
+        int32_t width;
+        int32_t height;
+        int32_t chunkSize;
+        uint32_t chunkCount;        // number of ChunkRecords that follow
+    };
+    struct PlayerRecord {
+        float acceleration[3];
+        float velocity[3];
+        float position[3];
+    };
+    struct ChunkRecord {
+        uint32_t index;             // chunk index, row by row
+        uint32_t size;              // payload size in bytes
+    };
+
+    // Appends a snapshot of level and player to out. A null base encodes a keyframe.
+    void encode(const Level& level, const Player& player, const Level* base, uint32_t sequence,
+                std::vector<uint8_t>& out);
+    // Applies a snapshot to level and player. For a delta snapshot they must
+    // already hold the state it was encoded against.
+    bool decode(const uint8_t* data, size_t size, Level& level, Player& player);
+
+    bool load(const std::string& path, Level& level, Player& player);
+}
+
+// Records snapshots without stalling the frame. capture() and save() only
+// copy the state (into recycled buffers) and hand it to a background thread,
+// which does the encoding and any file writes.
+//
+// The recorder keeps a bounded in-memory history of snapshots for rewind
+// and replay, with a keyframe every keyframeInterval snapshots.
+class SnapshotRecorder {
+    struct Capture {
+        Level level{0, 0};
+        Player player;
+        std::string path;           // non-empty for saves to file
+    };
+
+    const size_t maxHistory;
+    const uint32_t keyframeInterval;
+
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    // captures move pending -> working -> spare -> pending, so once every
+    // vector has grown to its working size queueing a capture is heap free
+    std::vector<Capture> pending;
+    std::vector<Capture> working;
+    std::vector<Capture> spare;
+    std::deque<std::vector<uint8_t>> history;
+    bool running{true};
+    bool busy{false};
+    bool forceKeyframe{true};
+
+    // only touched by the background thread
+    Level previous{0, 0};
+    uint32_t sequence{0};
+    std::vector<uint8_t> scratch;
+
+    std::atomic<uint64_t> bytesEncoded{0};
+    std::atomic<uint64_t> encodeNanoseconds{0};
+    std::atomic<uint64_t> bytesDecoded{0};
+    std::atomic<uint64_t> decodeNanoseconds{0};
+
+    void queue(const Level& level, const Player& player, const std::string& path);
+    void run();
+    void record(Capture& capture);
+
+public:
+    explicit SnapshotRecorder(size_t maxHistory = 256, uint32_t keyframeInterval = 16);
+    ~SnapshotRecorder();
+    SnapshotRecorder(const SnapshotRecorder&) = delete;
+    SnapshotRecorder& operator=(const SnapshotRecorder&) = delete;
+
+    // adds a snapshot to the history
+    void capture(const Level& level, const Player& player);
+    // writes a keyframe snapshot to a file
+    void save(const Level& level, const Player& player, const std::string& path);
+    // blocks until every queued capture and save is done
+    void flush();
+
+    size_t getHistorySize() const;
+    // restores snapshot index of the history (0 is the oldest)
+    bool restore(size_t index, Level& level, Player& player);
+    // restores snapshot index and forgets everything recorded after it
+    bool rewind(size_t index, Level& level, Player& player);
+
+    // throughput of the encoder and decoder, in snapshot bytes per millisecond
+    double getSaveBytesPerMs() const;
+    double getRestoreBytesPerMs() const;
+};
@@ -0,0 +1,132 @@
+#include "text.h"
+
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+    // index of a character's glyph in the font atlas, or -1 if it has none
+    int glyphIndex(const char c) {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return 26 + (c - 'a');
+        if (c >= '0' && c <= '9') return 52 + (c - '0');
+        switch (c) {
+        case '!': return 62;
+        case ',': return 63;
+        case '.': return 64;
+        default:  return -1;
+        }
+    }
+    constexpr int NUM_GLYPHS = 65;
+}
+
+// class ph::TextRenderer
+ph::TextRenderer::TextRenderer(const Archive& archive, const std::string& fontName,
+                               const std::string& vertexShaderName, const std::string& fragmentShaderName,
+                               const int screenWidth, const int screenHeight)
+    : atlas(archive, fontName), shader(archive, vertexShaderName, fragmentShaderName), batchVA({2, 2}) {
+    setScreenSize(screenWidth, screenHeight);
+
+    // every run of columns with some opaque pixel is a glyph; Texture has
+    // already reported a missing atlas, so just draw nothing then
+    const auto entry = archive.find(fontName);
+    if (entry && entry->type == archive::EntryType::Texture) {
+        const int width = entry->width, height = entry->height;
+        const uint8_t* pixels = archive.getData(*entry);    // mip level 0, RGBA
+        atlasWidth = static_cast<float>(width);
+        const auto isOpaque = [&](const int x) {
+            for (int y = 0; y < height; ++y) {
+                if (pixels[(y * width + x) * 4 + 3] != 0)
+                    return true;
+            }
+            return false;
+        };
+        for (int x = 0; x < width; ++x) {
+            if (!isOpaque(x))
+                continue;
+            const int first = x;
+            while (x < width && isOpaque(x))
+                ++x;
+            glyphs.push_back({first, x - first});
+        }
+        if (glyphs.size() != NUM_GLYPHS) {
+            std::cerr << "Warning: Font " << fontName << " has " << glyphs.size() << " glyphs instead of "
+                      << NUM_GLYPHS << "!\n";
+        }
+    }
+
+    gl::bind(shader);
+    gl::setUniform(shader, "uTexture", 0);
+}
+void ph::TextRenderer::setScreenSize(const int screenWidth, const int screenHeight) {
+    // y points down so text is laid out like on a page
+    projection = glm::ortho(0.0f, static_cast<float>(screenWidth), static_cast<float>(screenHeight), 0.0f);
+}
+void ph::TextRenderer::layout(const char* text, const glm::vec2& position, const float scale,
+                              std::vector<float>& out) const {
+    // texCoords are flipped since the atlas is stored upside down
+    const float h = GLYPH_HEIGHT * scale;
+
+    glm::vec2 pen = position;
+    for (const char* c = text; *c; ++c) {
+        if (*c == '\n') {
+            pen = {position.x, pen.y + h};
+            continue;
+        }
+        const int i = glyphIndex(*c);
+        if (i < 0 || i >= static_cast<int>(glyphs.size())) {
+            pen.x += (SPACE_WIDTH + GLYPH_SPACING) * scale;
+            continue;
+        }
+        const Glyph& glyph = glyphs[i];
+        const float w = glyph.width * scale;
+        const float u0 = glyph.x / atlasWidth;
+        const float u1 = (glyph.x + glyph.width) / atlasWidth;
+        const float quad[] = {
+            // positions                // texCoords
+            pen.x,      pen.y,          u0, 1.0f,   // top left
+            pen.x + w,  pen.y,          u1, 1.0f,   // top right
+            pen.x + w,  pen.y + h,      u1, 0.0f,   // bottom right
+            pen.x + w,  pen.y + h,      u1, 0.0f,   // bottom right
+            pen.x,      pen.y + h,      u0, 0.0f,   // bottom left
+            pen.x,      pen.y,          u0, 1.0f,   // top left
+        };
+        out.insert(out.end(), quad, quad + sizeof(quad)/sizeof(float));
+        pen.x += w + GLYPH_SPACING * scale;
+    }
+}
+ph::TextRenderer::TextID ph::TextRenderer::cache(const std::string& text, const glm::vec2& position,
+                                                 const float scale) {
+    std::vector<float> vertices;
+    layout(text.c_str(), position, scale, vertices);
+    cached.push_back(std::move(vertices));
+    return cached.size() - 1;
+}
+void ph::TextRenderer::add(const TextID text) {
+    const auto& vertices = cached[text];
+    batch.insert(batch.end(), vertices.begin(), vertices.end());
+}
+void ph::TextRenderer::add(const char* text, const glm::vec2& position, const float scale) {
+    layout(text, position, scale, batch);
+}
+void ph::TextRenderer::draw(const glm::vec3& color) {
+    if (batch.empty())
+        return;
+    batchVA.update(batch.data(), batch.size());
+    // clear() keeps the capacity, so a steady HUD stops allocating after the first frame
+    batch.clear();
+
+    // text is an overlay: no depth test, alpha blended over the scene
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    gl::bind(atlas);
+    gl::bind(shader);
+    gl::bind(batchVA);
+    gl::setUniform(shader, "uProjection", projection);
+    gl::setUniform(shader, "uColor", color);
+    gl::draw(batchVA);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
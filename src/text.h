@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ph.h"
+
+namespace ph {
+    // Renders text from a bitmap font atlas. All text added during a frame is
+    // laid out into one streaming vertex buffer and drawn with a single draw
+    // call. Strings that never change can be cached: their vertices are built
+    // once and adding them to a frame is a plain copy.
+    //
+    // The font atlas is a single row of variable-width glyphs in the order
+    // A-Z, a-z, 0-9, '!', ',', '.', separated by fully transparent columns;
+    // any other character is drawn as a space. Where each glyph starts and how
+    // wide it is are found by scanning the atlas's alpha once at load.
+    // Text is positioned in pixels with the origin at the top left of the screen.
+    class TextRenderer {
+    public:
+        using TextID = size_t;
+
+    private:
+        struct Glyph {
+            int x;                  // first column in the atlas (px)
+            int width;              // (px)
+        };
+
+        const Texture atlas;
+        float atlasWidth{1.0f};
+        std::vector<Glyph> glyphs;
+        const Shader shader;
+        VertexArray batchVA;
+        std::vector<float> batch;
+        std::vector<std::vector<float>> cached;
+        glm::mat4 projection;
+
+        void layout(const char* text, const glm::vec2& position, float scale, std::vector<float>& out) const;
+
+    public:
+        static constexpr int GLYPH_WIDTH = 9;       // advance of the widest glyphs, e.g. for lining up columns (px)
+        static constexpr int GLYPH_HEIGHT = 13;     // line height (px)
+        static constexpr int GLYPH_SPACING = 2;     // between glyphs (px)
+        static constexpr int SPACE_WIDTH = 5;       // of a space, before spacing (px)
+
+        TextRenderer(const Archive& archive, const std::string& fontName, const std::string& vertexShaderName,
+                     const std::string& fragmentShaderName, int screenWidth, int screenHeight);
+
+        void setScreenSize(int screenWidth, int screenHeight);
+
+        // builds the vertices of a static string once
+        TextID cache(const std::string& text, const glm::vec2& position, float scale = 1.0f);
+        // queues text for this frame; takes a C string so per-frame
+        // text can be formatted into a stack buffer without allocating
+        void add(TextID text);
+        void add(const char* text, const glm::vec2& position, float scale = 1.0f);
+
+        // draws everything queued since the last call with one draw call
+        void draw(const glm::vec3& color = glm::vec3{1.0f, 1.0f, 1.0f});
+    };
+}
@@ -0,0 +1,171 @@
+// Bakes the resources directory into a single archive (see src/archive.h).
+// Textures are decoded, flipped and mipmapped here, once, so that the game
+// only has to map the archive and upload the pixels.
+//
+// usage: pack <output archive> <resource root> <files...>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "archive.h"
+
+namespace {
+    struct Item {
+        ph::archive::Entry entry;
+        std::vector<uint8_t> payload;
+    };
+
+    bool isTexture(const std::string& name) {
+        const auto dot = name.rfind('.');
+        if (dot == std::string::npos)
+            return false;
+        std::string ext = name.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "bmp" || ext == "tga";
+    }
+
+    // decodes an image to RGBA8 and appends its mip chain, halving with a box filter
+    bool bakeTexture(const std::string& path, Item& item) {
+        // match ph::Texture, which loads images upside down for OpenGL
+        stbi_set_flip_vertically_on_load(true);
+        int width, height, numChannels;
+        stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &numChannels, 4);
+        if (!pixels) {
+            std::cerr << "Error: Failed to load image at " << path << "! (" << stbi_failure_reason() << ")\n";
+            return false;
+        }
+        item.entry.type = ph::archive::EntryType::Texture;
+        item.entry.width = width;
+        item.entry.height = height;
+        item.entry.mipLevels = 1;
+
+        std::vector<uint8_t> level(pixels, pixels + width * height * 4);
+        stbi_image_free(pixels);
+        item.payload = level;
+
+        int w = width, h = height;
+        while (w > 1 || h > 1) {
+            const int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+            std::vector<uint8_t> next(nw * nh * 4);
+            for (int y = 0; y < nh; ++y) {
+                for (int x = 0; x < nw; ++x) {
+                    // clamp so odd and 1 px wide levels still average valid texels
+                    const int x0 = 2 * x, x1 = std::min(2 * x + 1, w - 1);
+                    const int y0 = 2 * y, y1 = std::min(2 * y + 1, h - 1);
+                    for (int c = 0; c < 4; ++c) {
+                        const int sum = level[(y0 * w + x0) * 4 + c] + level[(y0 * w + x1) * 4 + c] +
+                                        level[(y1 * w + x0) * 4 + c] + level[(y1 * w + x1) * 4 + c];
+                        next[(y * nw + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                    }
+                }
+            }
+            item.payload.insert(item.payload.end(), next.begin(), next.end());
+            level.swap(next);
+            w = nw;
+            h = nh;
+            ++item.entry.mipLevels;
+        }
+        return true;
+    }
+
+    bool readRaw(const std::string& path, Item& item) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Error: Failed to open " << path << "!\n";
+            return false;
+        }
+        item.entry.type = ph::archive::EntryType::Raw;
+        item.payload.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    size_t align(const size_t offset) {
+        return (offset + ph::archive::PAYLOAD_ALIGNMENT - 1) / ph::archive::PAYLOAD_ALIGNMENT *
+               ph::archive::PAYLOAD_ALIGNMENT;
+    }
+}
+
+int main(int argc, char** argv) {
+    using namespace ph;
+
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <output archive> <resource root> <files...>\n";
+        return EXIT_FAILURE;
+    }
+    const std::string outputPath = argv[1];
+    std::string root = argv[2];
+    std::replace(root.begin(), root.end(), '\\', '/');
+    if (!root.empty() && root.back() != '/')
+        root += '/';
+
+    // BAKE ENTRIES
+    std::vector<Item> items;
+    for (int i = 3; i < argc; ++i) {
+        std::string path = argv[i];
+        std::replace(path.begin(), path.end(), '\\', '/');
+        if (path.compare(0, root.size(), root) != 0) {
+            std::cerr << "Error: " << path << " is not inside " << root << "!\n";
+            return EXIT_FAILURE;
+        }
+        const std::string name = path.substr(root.size());
+
+        Item item{};
+        if (name.size() >= sizeof(item.entry.name)) {
+            std::cerr << "Error: Resource name " << name << " is too long!\n";
+            return EXIT_FAILURE;
+        }
+        std::strncpy(item.entry.name, name.c_str(), sizeof(item.entry.name));
+
+        if (!(isTexture(name) ? bakeTexture(path, item) : readRaw(path, item)))
+            return EXIT_FAILURE;
+        item.entry.size = item.payload.size();
+        items.push_back(std::move(item));
+    }
+
+    // the index is binary searched at runtime
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return std::strcmp(a.entry.name, b.entry.name) < 0;
+    });
+
+    // LAY OUT PAYLOADS
+    size_t offset = align(sizeof(archive::Header) + items.size() * sizeof(archive::Entry));
+    for (auto& item : items) {
+        item.entry.offset = offset;
+        offset = align(offset + item.payload.size());
+    }
+
+    // WRITE ARCHIVE
+    std::ofstream file(outputPath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Failed to open " << outputPath << " for writing!\n";
+        return EXIT_FAILURE;
+    }
+    archive::Header header{};
+    std::memcpy(header.magic, archive::MAGIC, 4);
+    header.version = archive::VERSION;
+    header.entryCount = items.size();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& item : items)
+        file.write(reinterpret_cast<const char*>(&item.entry), sizeof(item.entry));
+
+    const char padding[archive::PAYLOAD_ALIGNMENT] = {};
+    for (const auto& item : items) {
+        file.write(padding, static_cast<std::streamsize>(item.entry.offset - static_cast<uint64_t>(file.tellp())));
+        file.write(reinterpret_cast<const char*>(item.payload.data()), item.payload.size());
+    }
+    if (!file) {
+        std::cerr << "Error: Failed to write " << outputPath << "!\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Packed " << items.size() << " resources into " << outputPath << " (" << file.tellp() << " bytes)\n";
+    return EXIT_SUCCESS;
+}